@@ -0,0 +1,449 @@
+/*
+ *	2020 (C) The Pulsar Engineering
+ *	http://www.thepulsar.be
+ *
+ *	This document is licensed under the CERN OHL-W v2 (http://ohwr.org/cernohl).
+ *
+ *	You may redistribute and modify this document under the terms of the
+ *	CERN OHL-W v2 only. This document is distributed WITHOUT ANY EXPRESS OR
+ *	IMPLIED WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY AND
+ *	FITNESS FOR APARTICULAR PURPOSE. Please refer to the CERN OHL-W v2 for
+ *	applicable conditions.
+ */
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../utils/utils.h"
+
+#include "banded.h"
+#include "calibration.h"
+#include "peakfit.h"
+#include "sampling.h"
+#include "vector.h"
+#include "simd.h"
+
+// result of a single benchmark
+struct BenchmarkResult
+{
+	std::string name;
+
+	double fTime;			// seconds per call
+	double fThroughput;		// GB/s, zero if not relevant
+};
+
+// return average time of a function call in seconds
+static double benchmark(std::function<void(void)> func, double fMinDuration = 0.05)
+{
+	// warm up caches
+	func();
+
+	// repeat until minimum duration is reached
+	size_t nCalls = 0;
+
+	double fStart = getPreciseTime();
+	double fElapsed = 0;
+
+	do
+	{
+		func();
+
+		nCalls++;
+
+		fElapsed = getPreciseTime() - fStart;
+
+	} while (fElapsed < fMinDuration);
+
+	return fElapsed / (double)nCalls;
+}
+
+// convert benchmark result to string
+static std::string toString(const BenchmarkResult& rResult)
+{
+	char szTmp[256];
+
+	if (rResult.fThroughput > 0)
+		sprintf_s(szTmp, "%-32s %10.3f us %8.2f GB/s", rResult.name.c_str(), 1e6 * rResult.fTime, rResult.fThroughput);
+	else
+		sprintf_s(szTmp, "%-32s %10.3f us", rResult.name.c_str(), 1e6 * rResult.fTime);
+
+	return std::string(szTmp);
+}
+
+// throughput of the SIMD kernels for every instruction set supported by the processor
+template<typename Type = double> static std::vector<BenchmarkResult> benchmark_simd(size_t nSize = 4096)
+{
+	std::vector<BenchmarkResult> ret;
+
+	// input and output data
+	auto a = linspace<Type>(-1, 1, nSize);
+	auto b = linspace<Type>(1, -1, nSize);
+
+	std::vector<Type> dst(nSize);
+
+	volatile Type fSink = 0;
+
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 };
+
+	for (auto eLevel : levels)
+	{
+		if (!simd_supported(eLevel))
+			continue;
+
+		auto k = simd_kernels<Type>(eLevel);
+
+		// register a kernel timing, nStreams is the number of vectors read or written
+		auto add = [&](const char* pszKernel, size_t nStreams, std::function<void(void)> func)
+		{
+			BenchmarkResult res;
+
+			res.name = std::string(k.name) + std::string(sizeof(Type) == sizeof(float) ? "::f32::" : "::f64::") + std::string(pszKernel);
+			res.fTime = benchmark(func);
+			res.fThroughput = 1e-9 * (double)(nStreams * nSize * sizeof(Type)) / res.fTime;
+
+			ret.emplace_back(std::move(res));
+		};
+
+		add("add", 3, [&]() { k.add(dst.data(), a.data(), b.data(), nSize); });
+		add("sub", 3, [&]() { k.sub(dst.data(), a.data(), b.data(), nSize); });
+		add("scale", 2, [&]() { k.scale(dst.data(), a.data(), (Type)0.5, nSize); });
+		add("fma", 3, [&]() { k.fma(dst.data(), a.data(), (Type)0.5, b.data(), nSize); });
+		add("min", 3, [&]() { k.vmin(dst.data(), a.data(), b.data(), nSize); });
+		add("max", 3, [&]() { k.vmax(dst.data(), a.data(), b.data(), nSize); });
+		add("clamp", 2, [&]() { k.clamp(dst.data(), a.data(), -(Type)0.5, (Type)0.5, nSize); });
+		add("sum", 1, [&]() { fSink = k.sum(a.data(), nSize); });
+		add("dot", 2, [&]() { fSink = k.dot(a.data(), b.data(), nSize); });
+		add("minval", 1, [&]() { fSink = k.minval(a.data(), nSize); });
+		add("maxval", 1, [&]() { fSink = k.maxval(a.data(), nSize); });
+	}
+
+	return ret;
+}
+
+// direct against FFT convolution for growing kernel sizes
+static std::vector<BenchmarkResult> benchmark_conv(size_t nSize = 4096)
+{
+	std::vector<BenchmarkResult> ret;
+
+	auto x = linspace(-1, 1, nSize);
+
+	vector_t y(nSize);
+
+	const size_t kernels[] = { 15, 63, 255, 1023 };
+
+	for (auto nKernelSize : kernels)
+	{
+		vector_t kernel(nKernelSize, 1.0 / (double)nKernelSize);
+
+		char szTmp[64];
+
+		BenchmarkResult res;
+
+		sprintf_s(szTmp, "conv::direct::k=%zu", nKernelSize);
+
+		res.name = std::string(szTmp);
+		res.fTime = benchmark([&]() { conv_direct_into(y, x, kernel); });
+		res.fThroughput = 0;
+
+		ret.push_back(res);
+
+		sprintf_s(szTmp, "conv::fft::k=%zu", nKernelSize);
+
+		res.name = std::string(szTmp);
+		res.fTime = benchmark([&]() { conv_fft_into(y, x, kernel); });
+
+		ret.push_back(res);
+	}
+
+	return ret;
+}
+
+// banded Cholesky factorization and solve of a second order penalty, as in Whittaker smoothing
+static std::vector<BenchmarkResult> benchmark_banded(size_t nSize = 2048)
+{
+	std::vector<BenchmarkResult> ret;
+
+	vector_t x(nSize, 1.0);
+
+	const size_t orders[] = { 1, 2, 3 };
+
+	for (auto nOrder : orders)
+	{
+		auto A = difference_penalty(nSize, nOrder, 1e5);
+
+		A.addDiagonal(1.0);
+
+		BandedCholesky cholesky;
+
+		char szTmp[64];
+
+		BenchmarkResult res;
+
+		sprintf_s(szTmp, "banded::factor::b=%zu", nOrder);
+
+		res.name = std::string(szTmp);
+		res.fTime = benchmark([&]() { cholesky.factor(A); });
+		res.fThroughput = 0;
+
+		ret.push_back(res);
+
+		sprintf_s(szTmp, "banded::solve::b=%zu", nOrder);
+
+		res.name = std::string(szTmp);
+		res.fTime = benchmark([&]() { cholesky.solve_inplace(x); });
+
+		ret.push_back(res);
+	}
+
+	return ret;
+}
+
+// peak fitting of a synthetic spectrum with isolated and overlapping bands
+static std::vector<BenchmarkResult> benchmark_peakfit(size_t nSize = 2048, size_t nNumPeaks = 40)
+{
+	std::vector<BenchmarkResult> ret;
+
+	const PeakProfile profiles[] = { PeakProfile::Gaussian, PeakProfile::Lorentzian, PeakProfile::PseudoVoigt };
+	const char* names[] = { "gaussian", "lorentzian", "voigt" };
+
+	for (size_t p = 0; p < 3; p++)
+	{
+		// every fourth band overlaps its neighbour
+		vector_t y(nSize, 0.0);
+		std::vector<size_t> peaks;
+
+		double fSpacing = (double)nSize / (double)(nNumPeaks + 1);
+
+		for (size_t k = 0; k < nNumPeaks; k++)
+		{
+			double fCenter = (double)(k + 1) * fSpacing - ((k % 4 == 3) ? 0.75 * fSpacing : 0.0);
+			double fWidth = 4.0 + (double)(k % 3);
+
+			peaks.push_back((size_t)(fCenter + 0.5));
+
+			for (size_t i = 0; i < nSize; i++)
+			{
+				double dc, dw, deta;
+
+				y[i] += (1.0 + 0.1 * (double)(k % 5)) * peak_profile(profiles[p], (double)i, fCenter, fWidth, 0.5, dc, dw, deta);
+			}
+		}
+
+		char szTmp[64];
+
+		BenchmarkResult res;
+
+		sprintf_s(szTmp, "peakfit::%s::n=%zu", names[p], nNumPeaks);
+
+		res.name = std::string(szTmp);
+		res.fTime = benchmark([&]() { fitPeaks(y, peaks, profiles[p]); });
+		res.fThroughput = 0;
+
+		ret.push_back(res);
+	}
+
+	return ret;
+}
+
+// return positions in [-1, 1] where a calibration model hits the reference lines, found by bisection
+template<size_t N> static vector_t calibration_problem(const std::array<double, N>& rModel, const vector_t& rLines)
+{
+	vector_t ret;
+
+	double fLow = index2wavelength(rModel, -1.0);
+	double fHigh = index2wavelength(rModel, 1.0);
+
+	for (auto& fLine : rLines)
+	{
+		if (fLine <= fLow || fLine >= fHigh)
+			continue;
+
+		double a = -1, b = 1;
+
+		for (size_t i = 0; i < 50; i++)
+		{
+			double c = 0.5 * (a + b);
+
+			if (index2wavelength(rModel, c) < fLine)
+				a = c;
+			else
+				b = c;
+		}
+
+		ret.push_back(0.5 * (a + b));
+	}
+
+	return ret;
+}
+
+// local searches from fixed starts, through std::function against the inlined simplex
+template<size_t N, typename CostFunction> static std::vector<BenchmarkResult> benchmark_fminsearch(const char* pszName, CostFunction cost, const std::array<double, N>& rMinBounds, const std::array<double, N>& rMaxBounds, size_t nNumStarts = 64)
+{
+	std::vector<BenchmarkResult> ret;
+
+	SobolSequence<N> sequence;
+
+	std::vector<std::array<double, N>> starts;
+
+	for (size_t i = 0; i < nNumStarts; i++)
+		starts.push_back(sequence.sample(i, rMinBounds, rMaxBounds));
+
+	volatile double fSink = 0;
+
+	char szTmp[64];
+
+	BenchmarkResult res;
+
+	sprintf_s(szTmp, "fminsearch::function::%s", pszName);
+
+	res.name = std::string(szTmp);
+	res.fTime = benchmark([&]() { for (auto& v : starts) fSink = fminsearch<N>(cost, v)[0]; }) / (double)nNumStarts;
+	res.fThroughput = 0;
+
+	ret.push_back(res);
+
+	sprintf_s(szTmp, "fminsearch::fast::%s", pszName);
+
+	res.name = std::string(szTmp);
+	res.fTime = benchmark([&]() { for (auto& v : starts) fSink = fminsearch_fast<N>(cost, v)[0]; }) / (double)nNumStarts;
+
+	ret.push_back(res);
+
+	return ret;
+}
+
+// local searches on the neon calibration problem of a given model, time per search
+template<size_t N> static std::vector<BenchmarkResult> benchmark_calibration(const char* pszName, const std::array<double, N>& rModel, const std::array<double, N>& rMinBounds, const std::array<double, N>& rMaxBounds)
+{
+	auto lines = getCalibrationData(CalibrationData::Neon);
+	auto peaks = calibration_problem(rModel, lines);
+
+	PeakIndex reference(lines);
+
+	auto cost = [&](const std::array<double, N>& coeffs)
+	{
+		double fCost = 0;
+
+		for (auto& v : peaks)
+			fCost += distPeaks(reference, index2wavelength(coeffs, v));
+
+		return fCost;
+	};
+
+	return benchmark_fminsearch<N>(pszName, cost, rMinBounds, rMaxBounds);
+}
+
+// local searches on the Rosenbrock function, where the cost is cheap and the overhead of the method shows
+template<size_t N> static std::vector<BenchmarkResult> benchmark_rosenbrock(void)
+{
+	auto cost = [](const std::array<double, N>& x)
+	{
+		double fCost = 0;
+
+		for (size_t i = 0; i + 1 < N; i++)
+			fCost += 100.0 * (x[i + 1] - x[i] * x[i]) * (x[i + 1] - x[i] * x[i]) + (1.0 - x[i]) * (1.0 - x[i]);
+
+		return fCost;
+	};
+
+	std::array<double, N> vec_min, vec_max;
+
+	vec_min.fill(-2);
+	vec_max.fill(2);
+
+	return benchmark_fminsearch<N>("rosenbrock", cost, vec_min, vec_max);
+}
+
+// evaluation of a calibration model on a sensor, coefficient by coefficient against the unrolled series
+template<size_t N> static std::vector<BenchmarkResult> benchmark_legendre(size_t nSize = 2048)
+{
+	std::vector<BenchmarkResult> ret;
+
+	std::array<double, N> coeffs;
+
+	for (size_t k = 0; k < N; k++)
+		coeffs[k] = 1.0 / (double)(k + 1);
+
+	vector_t x(nSize), y;
+
+	for (size_t i = 0; i < nSize; i++)
+		x[i] = 2 * (double)i / (double)(nSize - 1) - 1;
+
+	char szTmp[64];
+
+	BenchmarkResult res;
+
+	sprintf_s(szTmp, "legendre::loop::%zu", N);
+
+	res.name = std::string(szTmp);
+	res.fTime = benchmark([&]()
+	{
+		y.resize(nSize);
+
+		for (size_t i = 0; i < nSize; i++)
+		{
+			double fSum = 0;
+
+			for (size_t k = 0; k < N; k++)
+				fSum += coeffs[k] * legendre((unsigned int)k, x[i]);
+
+			y[i] = fSum;
+		}
+	});
+	res.fThroughput = 0;
+
+	ret.push_back(res);
+
+	sprintf_s(szTmp, "legendre::series::%zu", N);
+
+	res.name = std::string(szTmp);
+	res.fTime = benchmark([&]() { legendre_series_into(y, coeffs, x); });
+
+	ret.push_back(res);
+
+	return ret;
+}
+
+// run all benchmarks
+static std::vector<BenchmarkResult> benchmark_all(void)
+{
+	std::vector<BenchmarkResult> ret;
+
+	auto simd_results = benchmark_simd<double>();
+	auto simdf_results = benchmark_simd<float>();
+
+	ret.insert(ret.end(), simd_results.begin(), simd_results.end());
+	ret.insert(ret.end(), simdf_results.begin(), simdf_results.end());
+
+	auto conv_results = benchmark_conv();
+
+	ret.insert(ret.end(), conv_results.begin(), conv_results.end());
+
+	auto banded_results = benchmark_banded();
+
+	ret.insert(ret.end(), banded_results.begin(), banded_results.end());
+
+	auto peakfit_results = benchmark_peakfit();
+
+	ret.insert(ret.end(), peakfit_results.begin(), peakfit_results.end());
+
+	auto legendre4_results = benchmark_legendre<4>();
+	auto legendre8_results = benchmark_legendre<8>();
+
+	ret.insert(ret.end(), legendre4_results.begin(), legendre4_results.end());
+	ret.insert(ret.end(), legendre8_results.begin(), legendre8_results.end());
+
+	auto linear_results = benchmark_calibration<2>("linear", { 660, 70 }, { 500, 50 }, { 800, 75 });
+	auto cubic_results = benchmark_calibration<4>("cubic", { 660, 70, 1.5, -0.8 }, { 500, 50, -10, -10 }, { 800, 75, 10, 10 });
+	auto quintic_results = benchmark_calibration<6>("quintic", { 660, 70, 1.5, -0.8, 0.3, -0.1 }, { 500, 50, -10, -10, -10, -10 }, { 800, 75, 10, 10, 10, 10 });
+	auto rosenbrock_results = benchmark_rosenbrock<4>();
+
+	ret.insert(ret.end(), linear_results.begin(), linear_results.end());
+	ret.insert(ret.end(), cubic_results.begin(), cubic_results.end());
+	ret.insert(ret.end(), quintic_results.begin(), quintic_results.end());
+	ret.insert(ret.end(), rosenbrock_results.begin(), rosenbrock_results.end());
+
+	return ret;
+}
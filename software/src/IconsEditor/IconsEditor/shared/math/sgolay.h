@@ -12,13 +12,19 @@
  */
 #pragma once
 
+#include <math.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <tuple>
 
+#include "../utils/utils.h"
 #include "../utils/exception.h"
 
 #include "vector.h"
-#include "matrix.h"
-#include "power.h"
+#include "binomial.h"
 
 // InvalidSGolayParameterException exception class
 class InvalidSGolayParameterException : public IException
@@ -44,8 +50,234 @@ private:
     size_t m_nWindowSize, m_nOrder, m_nDerivative;
 };
 
-// Savitzky-Golay filter
-static vector_t sgolay(const vector_t& rInput, size_t nWindowSize, size_t nOrder, size_t nDerivative=0)
+// least-squares polynomial fit operator through Householder QR, returns C (nOrder x z.size(), row-major) such that a = C y
+static vector_t sgolay_solve(const vector_t& z, size_t nOrder)
+{
+    size_t w = z.size();
+    size_t p = nOrder;
+
+    // Vandermonde matrix, row-major
+    vector_t A(w * p);
+
+    for (size_t i = 0; i < w; i++)
+    {
+        double fValue = 1;
+
+        for (size_t j = 0; j < p; j++)
+        {
+            A[i * p + j] = fValue;
+            fValue *= z[i];
+        }
+    }
+
+    // QR factorization, reflectors are stored below the diagonal
+    vector_t rdiag(p), beta(p);
+
+    for (size_t k = 0; k < p; k++)
+    {
+        double fNorm = 0;
+
+        for (size_t i = k; i < w; i++)
+            fNorm += A[i * p + k] * A[i * p + k];
+
+        fNorm = sqrt(fNorm);
+
+        // rank deficient, should not happen if window is larger than order
+        if (fNorm == 0)
+            throwException(InvalidSGolayParameterException, w, p, 0);
+
+        double fAlpha = (A[k * p + k] > 0) ? -fNorm : fNorm;
+
+        A[k * p + k] -= fAlpha;
+
+        double fNorm2 = 0;
+
+        for (size_t i = k; i < w; i++)
+            fNorm2 += A[i * p + k] * A[i * p + k];
+
+        rdiag[k] = fAlpha;
+        beta[k] = 2.0 / fNorm2;
+
+        // apply reflector to remaining columns
+        for (size_t j = k + 1; j < p; j++)
+        {
+            double fDot = 0;
+
+            for (size_t i = k; i < w; i++)
+                fDot += A[i * p + k] * A[i * p + j];
+
+            for (size_t i = k; i < w; i++)
+                A[i * p + j] -= beta[k] * fDot * A[i * p + k];
+        }
+    }
+
+    // C = R^-1 Q^T, one column per sample
+    vector_t C(p * w), y(w);
+
+    for (size_t c = 0; c < w; c++)
+    {
+        for (size_t i = 0; i < w; i++)
+            y[i] = (i == c) ? 1.0 : 0.0;
+
+        // apply Q^T
+        for (size_t k = 0; k < p; k++)
+        {
+            double fDot = 0;
+
+            for (size_t i = k; i < w; i++)
+                fDot += A[i * p + k] * y[i];
+
+            for (size_t i = k; i < w; i++)
+                y[i] -= beta[k] * fDot * A[i * p + k];
+        }
+
+        // back substitution
+        for (size_t k = p; k-- > 0;)
+        {
+            double fValue = y[k];
+
+            for (size_t j = k + 1; j < p; j++)
+                fValue -= A[k * p + j] * C[j * w + c];
+
+            C[k * w + c] = fValue / rdiag[k];
+        }
+    }
+
+    return C;
+}
+
+// Savitzky-Golay coefficients of one (window, order, derivative) set
+struct SGolayCoefficients
+{
+    size_t nWindowSize, nOrder, nDerivative;
+
+    // coefficients at the window center
+    vector_t center;
+
+    // coefficients for the output at offset j of a window lying fully inside the vector
+    std::vector<vector_t> edges;
+};
+
+/*
+ *  Savitzky-Golay coefficients, nOrder includes the 0th order, always solved in double precision
+ *
+ *  The output is the d-th polynomial coefficient of the local fit, that is f^(d)(t)/d!, evaluated at the
+ *  sample position t. For even windows the center is half a sample before the output element, like conv().
+ */
+static std::shared_ptr<const SGolayCoefficients> sgolay_make_coeffs(size_t nWindowSize, size_t nOrder, size_t nDerivative)
+{
+    // sample positions, scaled to [-1, 1] to keep the Vandermonde matrix well conditioned
+    double fScale = max(1.0, 0.5 * ((double)nWindowSize - 1.0));
+
+    vector_t u(nWindowSize);
+
+    for (size_t j = 0; j < nWindowSize; j++)
+        u[j] = ((double)j - 0.5 * ((double)nWindowSize - 1.0)) / fScale;
+
+    auto C = sgolay_solve(u, nOrder);
+
+    // evaluate f^(d)(t)/d! as a linear combination of samples
+    auto evaluate = [&](double t)
+    {
+        vector_t ret(nWindowSize, 0.0);
+
+        double fFactor = 1.0 / pow(fScale, (double)nDerivative);
+
+        for (size_t q = nDerivative; q < nOrder; q++)
+        {
+            double fWeight = (double)binomial((unsigned int)q, (unsigned int)nDerivative) * pow(t / fScale, (double)(q - nDerivative)) * fFactor;
+
+            for (size_t j = 0; j < nWindowSize; j++)
+                ret[j] += fWeight * C[q * nWindowSize + j];
+        }
+
+        return ret;
+    };
+
+    auto pCoeffs = std::make_shared<SGolayCoefficients>();
+
+    pCoeffs->nWindowSize = nWindowSize;
+    pCoeffs->nOrder = nOrder;
+    pCoeffs->nDerivative = nDerivative;
+
+    pCoeffs->center = evaluate(0);
+
+    // output at offset j is (j - w/2) samples away from the center
+    pCoeffs->edges.resize(nWindowSize);
+
+    for (size_t j = 0; j < nWindowSize; j++)
+        pCoeffs->edges[j] = evaluate((double)j - (double)(nWindowSize >> 1));
+
+    return pCoeffs;
+}
+
+// thread-safe table of Savitzky-Golay coefficients
+class SGolayCache
+{
+public:
+
+    // return cache instance
+    static SGolayCache& instance(void)
+    {
+        static SGolayCache cache;
+
+        return cache;
+    }
+
+    // return coefficients, computed on first request
+    std::shared_ptr<const SGolayCoefficients> get(size_t nWindowSize, size_t nOrder, size_t nDerivative)
+    {
+        auto key = std::make_tuple(nWindowSize, nOrder, nDerivative);
+
+        {
+            AUTOLOCK(this->m_mutex);
+
+            auto it = this->m_table.find(key);
+
+            if (it != this->m_table.end())
+                return it->second;
+        }
+
+        // solve outside of the lock, another thread may insert the same set meanwhile
+        auto pCoeffs = sgolay_make_coeffs(nWindowSize, nOrder, nDerivative);
+
+        AUTOLOCK(this->m_mutex);
+
+        return this->m_table.emplace(key, pCoeffs).first->second;
+    }
+
+    // return number of cached sets
+    size_t size(void) const
+    {
+        AUTOLOCK(this->m_mutex);
+
+        return this->m_table.size();
+    }
+
+    // remove all sets
+    void clear(void)
+    {
+        AUTOLOCK(this->m_mutex);
+
+        this->m_table.clear();
+    }
+
+private:
+    SGolayCache(void) {}
+
+    mutable std::mutex m_mutex;
+
+    std::map<std::tuple<size_t, size_t, size_t>, std::shared_ptr<const SGolayCoefficients>> m_table;
+};
+
+// Savitzky-Golay convolution coefficients at the window center
+static vector_t sgolay_coeffs(size_t nWindowSize, size_t nOrder, size_t nDerivative)
+{
+    return SGolayCache::instance().get(nWindowSize, nOrder + 1, nDerivative)->center;
+}
+
+// Savitzky-Golay filter into output vector, input and output may be the same vector
+template<typename Type> static void sgolay_into(std::vector<Type>& rOutput, const std::vector<Type>& rInput, size_t nWindowSize, size_t nOrder, size_t nDerivative=0)
 {
     // always include 0th order
     nOrder++;
@@ -56,27 +288,81 @@ static vector_t sgolay(const vector_t& rInput, size_t nWindowSize, size_t nOrder
 
     // special case for boxcar
     if (nOrder == 1)
-        return boxcar(rInput, nWindowSize);
+    {
+        boxcar_into(rOutput, rInput, nWindowSize);
+
+        return;
+    }
 
-    // compute z vector
-    auto zvec = linspace((1.0 - (double)nWindowSize) * 0.5, ((double)nWindowSize - 1.0) * 0.5, nWindowSize);
+    // work on a copy if output overwrites input
+    if (&rOutput == &rInput)
+    {
+        auto tmp = scratch<Type>(rInput.size());
 
-    // compute J matrix
-    Matrix Jmat(nOrder, nWindowSize);
+        *tmp = rInput;
 
-    for (size_t j = 0; j < nWindowSize; j++)
-        for (size_t i = 0; i < nOrder; i++)
-            Jmat(i, j) = quickpow(zvec[j], (unsigned int)i);
+        sgolay_into(rOutput, *tmp, nWindowSize, nOrder - 1, nDerivative);
+
+        return;
+    }
+
+    auto pCoeffs = SGolayCache::instance().get(nWindowSize, nOrder, nDerivative);
+
+    // apply center coefficients with the vectorized convolution
+    auto kernel = scratch<Type>(nWindowSize);
+
+    convert_into(*kernel, pCoeffs->center);
+
+    conv_into(rOutput, rInput, *kernel);
+
+    // replace clamped samples by edge-fitted coefficients if the window fits into the vector
+    size_t n = rInput.size();
+
+    if (n < nWindowSize)
+        return;
+
+    size_t nHalf = nWindowSize >> 1;
+    size_t nTail = nWindowSize - 1 - nHalf;
 
-    // compute J matrix transposate
-    auto JmatT = Jmat.transpose();
+    // first elements use the first window
+    for (size_t i = 0; i < nHalf; i++)
+    {
+        auto& coeffs = pCoeffs->edges[i];
+
+        double fValue = 0;
+
+        for (size_t j = 0; j < nWindowSize; j++)
+            fValue += coeffs[j] * (double)rInput[j];
+
+        rOutput[i] = (Type)fValue;
+    }
+
+    // last elements use the last window
+    for (size_t i = n - nTail; i < n; i++)
+    {
+        auto& coeffs = pCoeffs->edges[i - (n - nWindowSize)];
 
-    // compute coefficient matrix according to formula
-    auto Cmat = inv(JmatT * Jmat) * JmatT;
+        double fValue = 0;
 
-    // extract coefficients
-    auto coeffs = Cmat.extractColumn(nDerivative);
+        for (size_t j = 0; j < nWindowSize; j++)
+            fValue += coeffs[j] * (double)rInput[n - nWindowSize + j];
 
-    // return convolution
-    return conv(rInput, coeffs);
+        rOutput[i] = (Type)fValue;
+    }
+}
+
+// Savitzky-Golay filter
+template<typename Type> static std::vector<Type> sgolay(const std::vector<Type>& rInput, size_t nWindowSize, size_t nOrder, size_t nDerivative=0)
+{
+    std::vector<Type> ret;
+
+    sgolay_into(ret, rInput, nWindowSize, nOrder, nDerivative);
+
+    return ret;
+}
+
+// Savitzky-Golay filter applied in place
+template<typename Type> static void sgolay_inplace(std::vector<Type>& vec, size_t nWindowSize, size_t nOrder, size_t nDerivative=0)
+{
+    sgolay_into(vec, vec, nWindowSize, nOrder, nDerivative);
 }
\ No newline at end of file
@@ -0,0 +1,78 @@
+/*
+ *	2020 (C) The Pulsar Engineering
+ *	http://www.thepulsar.be
+ *
+ *	This document is licensed under the CERN OHL-W v2 (http://ohwr.org/cernohl).
+ *
+ *	You may redistribute and modify this document under the terms of the
+ *	CERN OHL-W v2 only. This document is distributed WITHOUT ANY EXPRESS OR
+ *	IMPLIED WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY AND
+ *	FITNESS FOR APARTICULAR PURPOSE. Please refer to the CERN OHL-W v2 for
+ *	applicable conditions.
+ */
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <Windows.h>
+
+// return number of worker threads to use
+static size_t parallel_threads(void)
+{
+	size_t nThreads = (size_t)std::thread::hardware_concurrency();
+
+	return (nThreads == 0) ? 1 : nThreads;
+}
+
+/*
+ *	split [0, nCount) into contiguous chunks and run them on separate threads
+ *
+ *	Each chunk holds at least nMinChunk items so that small problems stay on the calling thread, which
+ *	always processes the first chunk itself. Exceptions raised by a worker are rethrown to the caller.
+ */
+static void parallel_for(size_t nCount, size_t nMinChunk, std::function<void(size_t, size_t)> func)
+{
+	if (nCount == 0)
+		return;
+
+	size_t nChunks = min(parallel_threads(), nCount / max((size_t)1, nMinChunk));
+
+	// run inline if not worth it
+	if (nChunks <= 1)
+	{
+		func(0, nCount);
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	std::vector<std::exception_ptr> errors(nChunks);
+
+	threads.reserve(nChunks - 1);
+
+	auto chunk = [&](size_t i)
+	{
+		try
+		{
+			func(i * nCount / nChunks, (i + 1) * nCount / nChunks);
+		}
+		catch (...)
+		{
+			errors[i] = std::current_exception();
+		}
+	};
+
+	for (size_t i = 1; i < nChunks; i++)
+		threads.emplace_back(chunk, i);
+
+	chunk(0);
+
+	for (auto& thread : threads)
+		thread.join();
+
+	for (auto& error : errors)
+		if (error)
+			std::rethrow_exception(error);
+}
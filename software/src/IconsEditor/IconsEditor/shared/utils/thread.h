@@ -78,13 +78,13 @@ public:
 		// reset quit var
 		this->m_bQuit = false;
 
+		// call onStart before the loop can check stopCondition
+		onStart();
+
 		// create thread
 		DWORD dwThreadID;
 
 		this->m_hThread = CreateThread(NULL, 0, &pfnRunThreadWinAPI, (LPVOID)this, 0, &dwThreadID);
-
-		// call onStart
-		onStart();
 	}
 
 	// stop thread
@@ -143,10 +143,16 @@ protected:
 		return false;
 	}
 
+	// return true if thread has been asked to stop, for long run() calls
+	bool isQuitting(void) const
+	{
+		return this->m_bQuit;
+	}
+
 	// every thread MUST implement this function
 	virtual void run(void) = 0;
 
-	// called after thread has started
+	// called before thread is started
 	virtual void onStart(void) {}
 
 	// called after thread has stopped
@@ -23,8 +23,9 @@
 #include "../utils/evemon.h"
 #include "../math/map.h"
 
-// version should match between exe and dll
-#define CAMINTERFACEVERSION     MAKEWORD(1,0)
+// version should match between exe and dll, major in low byte and minor in high byte
+// 2.0: image_t holds single precision pixels
+#define CAMINTERFACEVERSION     MAKEWORD(2,0)
 
 #if _USRDLL
 extern "C" _declspec(dllexport) unsigned long version(void);
@@ -307,7 +308,7 @@ private:
             // check that version is compatible
             auto lib_version = (*pVersionFunc)();
 
-            if (HIWORD(lib_version) != HIWORD(version()) || LOWORD(lib_version) < HIWORD(version()))
+            if (LOBYTE(lib_version) != LOBYTE(version()) || HIBYTE(lib_version) < HIBYTE(version()))
             {
                 _error("Incompatible version! Aborting");
 
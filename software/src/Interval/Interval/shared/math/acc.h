@@ -12,6 +12,8 @@
  */
 #pragma once
 
+#include <algorithm>
+
 #include "../utils/safe.h"
 
 #include "vector.h"
@@ -43,6 +45,16 @@ public:
         __INC(this->m_nNumData, (size_t)1);
     }
 
+    // add single precision vector, sums are kept in double precision
+    void add(const vectorf_t& vec)
+    {
+        auto tmp = scratch<double>(vec.size());
+
+        convert_into(*tmp, vec);
+
+        add(*tmp);
+    }
+
     // return true if accumulator has data
     bool valid(void) const
     {
@@ -61,6 +73,23 @@ public:
         return this->m_sum / (double)this->m_nNumData;
     }
 
+    // get average into output vector of any scalar type
+    template<typename Type> void mean(std::vector<Type>& rOutput) const
+    {
+        rOutput.resize(this->m_sum.size());
+
+        // no data returns null vector
+        if (this->m_nNumData == 0)
+        {
+            std::fill(rOutput.begin(), rOutput.end(), 0.0);
+
+            return;
+        }
+
+        for (size_t i = 0; i < rOutput.size(); i++)
+            rOutput[i] = (Type)(this->m_sum[i] / (double)this->m_nNumData);
+    }
+
     // get stdev
     vector_t stdev(void) const
     {
@@ -0,0 +1,384 @@
+/*
+ *	2020 (C) The Pulsar Engineering
+ *	http://www.thepulsar.be
+ *
+ *	This document is licensed under the CERN OHL-W v2 (http://ohwr.org/cernohl).
+ *
+ *	You may redistribute and modify this document under the terms of the
+ *	CERN OHL-W v2 only. This document is distributed WITHOUT ANY EXPRESS OR
+ *	IMPLIED WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY AND
+ *	FITNESS FOR APARTICULAR PURPOSE. Please refer to the CERN OHL-W v2 for
+ *	applicable conditions.
+ */
+#pragma once
+
+#include <string>
+
+#include "../utils/exception.h"
+#include "../utils/safe.h"
+
+#include "matrix.h"
+#include "vector.h"
+
+// OutsideBandException exception class
+class OutsideBandException : public IException
+{
+public:
+	OutsideBandException(size_t nRow, size_t nColumn, size_t nBandwidth)
+	{
+		this->m_nRow = nRow;
+		this->m_nColumn = nColumn;
+		this->m_nBandwidth = nBandwidth;
+	}
+
+	virtual std::string toString(void) const override
+	{
+		char szTmp[128];
+
+		sprintf_s(szTmp, "Element (%zu, %zu) is outside band of width %zu!", this->m_nRow, this->m_nColumn, this->m_nBandwidth);
+
+		return std::string(szTmp);
+	}
+
+private:
+	size_t m_nRow, m_nColumn, m_nBandwidth;
+};
+
+/*
+ *	symmetric band matrix
+ *
+ *	Only the lower band is stored, (b + 1) values per row with row i holding columns i - b to i in
+ *	increasing order. Memory and products are O(n b) instead of O(n^2).
+ */
+class BandedMatrix
+{
+public:
+	BandedMatrix(void)
+	{
+		this->m_nSize = 0;
+		this->m_nBandwidth = 0;
+	}
+
+	BandedMatrix(size_t nSize, size_t nBandwidth)
+	{
+		this->m_nSize = 0;
+		this->m_nBandwidth = 0;
+
+		resize(nSize, nBandwidth);
+	}
+
+	// change size and reset all elements to zero, keeps the allocation when possible
+	void resize(size_t nSize, size_t nBandwidth)
+	{
+		this->m_nSize = nSize;
+		this->m_nBandwidth = nBandwidth;
+
+		this->m_data.assign(__MULT(nSize, nBandwidth + 1), 0.0);
+	}
+
+	// set all elements to zero
+	void clear(void)
+	{
+		std::fill(this->m_data.begin(), this->m_data.end(), 0.0);
+	}
+
+	// return number of rows and columns
+	size_t size(void) const
+	{
+		return this->m_nSize;
+	}
+
+	// return number of sub-diagonals
+	size_t bandwidth(void) const
+	{
+		return this->m_nBandwidth;
+	}
+
+	// return element, zero outside band
+	double operator()(size_t i, size_t j) const
+	{
+		if (i >= this->m_nSize || j >= this->m_nSize)
+			throwException(OutsideBandException, i, j, this->m_nBandwidth);
+
+		if (j > i)
+			myswap(i, j);
+
+		if (i - j > this->m_nBandwidth)
+			return 0;
+
+		return this->m_data[index(i, j)];
+	}
+
+	// return reference to element (i, j), same as (j, i)
+	double& at(size_t i, size_t j)
+	{
+		if (i >= this->m_nSize || j >= this->m_nSize)
+			throwException(OutsideBandException, i, j, this->m_nBandwidth);
+
+		if (j > i)
+			myswap(i, j);
+
+		if (i - j > this->m_nBandwidth)
+			throwException(OutsideBandException, i, j, this->m_nBandwidth);
+
+		return this->m_data[index(i, j)];
+	}
+
+	// add vector to diagonal
+	void addDiagonal(const vector_t& rDiagonal)
+	{
+		if (rDiagonal.size() != this->m_nSize)
+			throwException(MatrixSizeMismatchException, this->m_nSize, this->m_nSize, rDiagonal.size(), 1);
+
+		for (size_t i = 0; i < this->m_nSize; i++)
+			this->m_data[index(i, i)] += rDiagonal[i];
+	}
+
+	// add constant to diagonal
+	void addDiagonal(double fValue)
+	{
+		for (size_t i = 0; i < this->m_nSize; i++)
+			this->m_data[index(i, i)] += fValue;
+	}
+
+	// return A x
+	vector_t operator*(const vector_t& x) const
+	{
+		size_t n = this->m_nSize;
+		size_t b = this->m_nBandwidth;
+
+		if (x.size() != n)
+			throwException(MatrixSizeMismatchException, n, n, x.size(), 1);
+
+		vector_t ret(n, 0.0);
+
+		for (size_t i = 0; i < n; i++)
+		{
+			const double* pRow = row(i);
+
+			// diagonal
+			ret[i] += pRow[b] * x[i];
+
+			// sub-diagonal elements also stand for their mirror above the diagonal
+			for (size_t j = (i > b) ? i - b : 0; j < i; j++)
+			{
+				double a = pRow[j + b - i];
+
+				ret[i] += a * x[j];
+				ret[j] += a * x[i];
+			}
+		}
+
+		return ret;
+	}
+
+	// convert to dense matrix
+	Matrix toMatrix(void) const
+	{
+		Matrix ret(this->m_nSize, this->m_nSize);
+
+		for (size_t i = 0; i < this->m_nSize; i++)
+			for (size_t j = (i > this->m_nBandwidth) ? i - this->m_nBandwidth : 0; j <= i; j++)
+			{
+				ret(i, j) = this->m_data[index(i, j)];
+				ret(j, i) = this->m_data[index(i, j)];
+			}
+
+		return ret;
+	}
+
+	// unchecked access to stored part of row i, element j is at offset j + b - i
+	double* row(size_t i)
+	{
+		return this->m_data.data() + i * (this->m_nBandwidth + 1);
+	}
+
+	const double* row(size_t i) const
+	{
+		return this->m_data.data() + i * (this->m_nBandwidth + 1);
+	}
+
+private:
+	size_t index(size_t i, size_t j) const
+	{
+		return i * (this->m_nBandwidth + 1) + (j + this->m_nBandwidth - i);
+	}
+
+	size_t m_nSize, m_nBandwidth;
+
+	vector_t m_data;
+};
+
+/*
+ *	Cholesky factorization of a symmetric positive definite band matrix, A = L L^T
+ *
+ *	L keeps the bandwidth of A so that factorization is O(n b^2) and each solve is O(n b). The object
+ *	keeps its buffers between factorizations and can solve any number of right-hand sides per
+ *	factorization, which is what iterative penalized solvers need.
+ */
+class BandedCholesky
+{
+public:
+	BandedCholesky(void)
+	{
+		this->m_bValid = false;
+	}
+
+	BandedCholesky(const BandedMatrix& rMatrix)
+	{
+		this->m_bValid = false;
+
+		factor(rMatrix);
+	}
+
+	// factorize matrix, throws if not positive definite
+	void factor(const BandedMatrix& rMatrix)
+	{
+		this->m_bValid = false;
+
+		size_t n = rMatrix.size();
+		size_t b = rMatrix.bandwidth();
+
+		if (n == 0)
+			throwException(MatrixWrongSizeException, n, n);
+
+		// reuse allocation if dimensions did not change
+		if (this->m_l.size() != n || this->m_l.bandwidth() != b)
+			this->m_l.resize(n, b);
+
+		for (size_t i = 0; i < n; i++)
+		{
+			const double* pA = rMatrix.row(i);
+			double* pLi = this->m_l.row(i);
+
+			size_t j0 = (i > b) ? i - b : 0;
+
+			for (size_t j = j0; j <= i; j++)
+			{
+				const double* pLj = this->m_l.row(j);
+
+				// sum over k in [max(0, i - b), j) of L(i, k) L(j, k), both rows are contiguous in k
+				double fValue = pA[j + b - i];
+
+				for (size_t k = j0; k < j; k++)
+					fValue -= pLi[k + b - i] * pLj[k + b - j];
+
+				if (j == i)
+				{
+					if (fValue <= 0)
+						throwException(MatrixNotPositiveDefiniteException);
+
+					pLi[b] = sqrt(fValue);
+				}
+				else
+					pLi[j + b - i] = fValue / pLj[b];
+			}
+		}
+
+		this->m_bValid = true;
+	}
+
+	// return true if a factorization is available
+	bool isValid(void) const
+	{
+		return this->m_bValid;
+	}
+
+	// return number of unknowns
+	size_t size(void) const
+	{
+		return this->m_l.size();
+	}
+
+	// solve A x = b in place
+	void solve_inplace(vector_t& x) const
+	{
+		if (!this->m_bValid)
+			throwException(MatrixNotPositiveDefiniteException);
+
+		size_t n = this->m_l.size();
+		size_t b = this->m_l.bandwidth();
+
+		if (x.size() != n)
+			throwException(MatrixSizeMismatchException, n, n, x.size(), 1);
+
+		// L y = b
+		for (size_t i = 0; i < n; i++)
+		{
+			const double* pLi = this->m_l.row(i);
+
+			double fValue = x[i];
+
+			for (size_t k = (i > b) ? i - b : 0; k < i; k++)
+				fValue -= pLi[k + b - i] * x[k];
+
+			x[i] = fValue / pLi[b];
+		}
+
+		// L^T x = y
+		for (size_t i = n; i-- > 0;)
+		{
+			double fValue = x[i];
+
+			for (size_t k = i + 1; k < min(n, i + b + 1); k++)
+				fValue -= this->m_l.row(k)[i + b - k] * x[k];
+
+			x[i] = fValue / this->m_l.row(i)[b];
+		}
+	}
+
+	// solve A x = b
+	vector_t solve(const vector_t& rb) const
+	{
+		auto x = rb;
+
+		solve_inplace(x);
+
+		return x;
+	}
+
+	// return log of determinant, determinant itself over- or underflows quickly for spectra
+	double logdet(void) const
+	{
+		double fSum = 0;
+
+		for (size_t i = 0; i < this->m_l.size(); i++)
+			fSum += log(this->m_l.row(i)[this->m_l.bandwidth()]);
+
+		return 2.0 * fSum;
+	}
+
+private:
+	BandedMatrix m_l;
+
+	bool m_bValid;
+};
+
+// return lambda * D^T D with D the (n - d) x n matrix of order d finite differences, bandwidth is d
+static BandedMatrix difference_penalty(size_t nSize, size_t nOrder, double fLambda)
+{
+	BandedMatrix ret(nSize, nOrder);
+
+	if (nSize <= nOrder)
+		return ret;
+
+	// coefficients of order d difference, (-1)^(d-k) binomial(d, k)
+	vector_t coeffs(nOrder + 1, 0.0);
+
+	coeffs[0] = 1;
+
+	for (size_t d = 0; d < nOrder; d++)
+		for (size_t k = d + 1; k-- > 0;)
+		{
+			coeffs[k + 1] += coeffs[k];
+			coeffs[k] = -coeffs[k];
+		}
+
+	// accumulate each row of D as an outer product
+	for (size_t r = 0; r + nOrder < nSize; r++)
+		for (size_t p = 0; p <= nOrder; p++)
+			for (size_t q = 0; q <= p; q++)
+				ret.row(r + p)[(r + q) + nOrder - (r + p)] += fLambda * coeffs[p] * coeffs[q];
+
+	return ret;
+}
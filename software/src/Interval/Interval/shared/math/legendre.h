@@ -17,10 +17,10 @@
 
 #include <math.h>
 
-#include "binomial.h"
-#include "power.h"
+#include <array>
+#include <vector>
 
-// legendre polynomial
+// legendre polynomial, by the three-term recurrence (k + 1) P(k+1) = (2k + 1) x P(k) - k P(k-1)
 static double legendre(unsigned int n, double x)
 {
     // precomputed cases for faster access
@@ -40,14 +40,105 @@ static double legendre(unsigned int n, double x)
     }
 
     // generic case
-    double y = 0;
+    double p0 = 1, p1 = x;
 
-    for (unsigned int k = 0; k <= n; k++)
+    for (unsigned int k = 1; k < n; k++)
     {
-        auto b = binomial(n, k);
+        double p2 = ((double)(2 * k + 1) * x * p1 - (double)k * p0) / (double)(k + 1);
 
-        y += b * b * quickpow(x - 1.0, n - k) * quickpow(x + 1.0, k);
+        p0 = p1;
+        p1 = p2;
     }
 
-    return y / (double)(1 << n);
-}
\ No newline at end of file
+    return p1;
+}
+
+// factors of the recurrence P(k+1) = alpha(k) x P(k) - (k / (k + 1)) P(k-1), with alpha(k) = (2k + 1) / (k + 1)
+constexpr double legendre_alpha(size_t k)
+{
+    return (double)(2 * k + 1) / (double)(k + 1);
+}
+
+// factor (k + 1) / (k + 2) weighting b(k+2) in Clenshaw's recurrence, and P(k) in the upward recurrence for P(k+2)
+constexpr double legendre_beta(size_t k)
+{
+    return (double)(k + 1) / (double)(k + 2);
+}
+
+/*
+ *  unrolled recurrences
+ *
+ *  Each step is a separate instantiation whose factors are constants folded from legendre_alpha() and legendre_beta()
+ *  at compile time, so that a series of N terms compiles into N multiply-add pairs without loop nor division.
+ */
+template<size_t K, size_t N> struct LegendreRecurrence
+{
+    // Clenshaw step for term K - 1, b1 and b2 being b(K) and b(K+1)
+    static double clenshaw(const std::array<double, N>& rCoeffs, double x, double b1, double b2)
+    {
+        constexpr double alpha = legendre_alpha(K - 1);
+        constexpr double beta = legendre_beta(K - 1);
+
+        return LegendreRecurrence<K - 1, N>::clenshaw(rCoeffs, x, rCoeffs[K - 1] + alpha * x * b1 - beta * b2, b1);
+    }
+
+    // upward step filling P(N - K) from the two previous ones
+    static void upward(std::array<double, N>& rBasis, double x)
+    {
+        constexpr size_t k = N - K;
+        constexpr double alpha = legendre_alpha(k - 1);
+        constexpr double beta = legendre_beta(k - 2);
+
+        rBasis[k] = alpha * x * rBasis[k - 1] - beta * rBasis[k - 2];
+
+        LegendreRecurrence<K - 1, N>::upward(rBasis, x);
+    }
+};
+
+template<size_t N> struct LegendreRecurrence<0, N>
+{
+    static double clenshaw(const std::array<double, N>&, double, double b1, double)
+    {
+        return b1;
+    }
+
+    static void upward(std::array<double, N>&, double)
+    {
+    }
+};
+
+// values of P(k, x) for k < N, which are also the derivatives of a series with respect to its coefficients
+template<size_t N> static std::array<double, N> legendre_basis(double x)
+{
+    std::array<double, N> ret;
+
+    ret[0] = 1;
+
+    if (N > 1)
+        ret[1] = x;
+
+    LegendreRecurrence<(N > 2) ? N - 2 : 0, N>::upward(ret, x);
+
+    return ret;
+}
+
+/*
+ *  sum of c[k] P(k, x) for k < N by Clenshaw's recurrence
+ *
+ *  Runs backwards through the coefficients with b(k) = c[k] + alpha(k) b(k+1) + beta(k+1) b(k+2), where
+ *  alpha(k) = (2k + 1) x / (k + 1) and beta(k) = -k / (k + 1), the sum being b(0). This costs one
+ *  multiply-add pair per term instead of evaluating every polynomial separately.
+ */
+template<size_t N> static double legendre_series(const std::array<double, N>& rCoeffs, double x)
+{
+    return LegendreRecurrence<N, N>::clenshaw(rCoeffs, x, 0, 0);
+}
+
+// evaluate legendre series at every point, the loop over points has a fixed body and vectorizes
+template<size_t N> static void legendre_series_into(std::vector<double>& rOutput, const std::array<double, N>& rCoeffs, const std::vector<double>& x)
+{
+    rOutput.resize(x.size());
+
+    for (size_t i = 0; i < x.size(); i++)
+        rOutput[i] = LegendreRecurrence<N, N>::clenshaw(rCoeffs, x[i], 0, 0);
+}
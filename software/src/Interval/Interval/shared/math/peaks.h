@@ -98,159 +98,279 @@ static auto refinePeaksPosition(const vector_t& x, const vector_t& y, const std:
 	return ret_s;
 }
 
-// find peaks in vector
-static std::vector<size_t> findPeaks(const vector_t& vec, size_t nNumPeaks, double fThreshold)
+// local maximum with its topographic prominence
+struct PeakInfo
+{
+	size_t nPos;				// index of maximum, middle of flat tops
+	double fHeight;				// value at maximum
+	double fProminence;			// height above the highest saddle to a higher point, above the lowest point for the global maximum
+	size_t nLeftBase, nRightBase;	// position of the minimum on each side before a higher point or the border
+};
+
+// find all local maxima in one pass, borders count as maxima when above their only neighbour
+static std::vector<PeakInfo> findLocalMaxima(const vector_t& vec)
 {
-	// find maximum of masked vector
-	auto find_max = [](const vector_t& vec, const std::vector<bool>& mask)
+	std::vector<PeakInfo> peaks;
+
+	size_t n = vec.size();
+
+	if (n == 0)
+		return peaks;
+
+	size_t i = 0;
+
+	while (i < n)
 	{
-		struct
-		{
-			double fValue;
-			size_t nPos;
-			bool bError;
-		} ret;
+		// extend flat top
+		size_t j = i;
+
+		while (j + 1 < n && vec[j + 1] == vec[i])
+			j++;
 
-		ret.bError = true;
+		bool bRising = (i == 0) || vec[i - 1] < vec[i];
+		bool bFalling = (j + 1 == n) || vec[j + 1] < vec[i];
 
-		// loop through vector
-		for (size_t i = 0; i < vec.size(); i++)
+		// ignore single sample vectors and constant vectors
+		if (bRising && bFalling && !(i == 0 && j + 1 == n))
 		{
-			// check for maximum
-			if (mask[i] && (ret.bError || vec[i] > ret.fValue))
-			{
-				ret.fValue = vec[i];
-				ret.nPos = i;
-				ret.bError = false;
-			}
+			PeakInfo peak;
+
+			peak.nPos = (i + j) / 2;
+			peak.fHeight = vec[peak.nPos];
+			peak.fProminence = 0;
+			peak.nLeftBase = peak.nPos;
+			peak.nRightBase = peak.nPos;
+
+			peaks.emplace_back(peak);
 		}
 
-		return ret;
+		i = j + 1;
+	}
+
+	return peaks;
+}
+
+/*
+ *	prominence of sorted peaks
+ *
+ *	Each side is scanned once with a monotonic stack holding decreasing values, every entry carrying the
+ *	minimum of the samples it covers. Popping the entries not higher than the current sample merges their
+ *	minima, so that the remaining top is the nearest higher point and the merged minimum is the lowest
+ *	sample in between. This is O(n) overall instead of one walk per peak.
+ */
+static void computeProminences(const vector_t& vec, std::vector<PeakInfo>& rPeaks)
+{
+	struct Entry
+	{
+		double fValue;
+		double fMin;
+		size_t nMinPos;
 	};
 
+	size_t n = vec.size();
 
-	// return vector of positions
-	std::vector<size_t> peaks;
+	if (n == 0 || rPeaks.size() == 0)
+		return;
 
-	// mask for peaks are initialize true
-	std::vector<bool> mask(vec.size());
+	// saddle on each side, only valid if a higher point exists on that side
+	std::vector<double> left_min(rPeaks.size()), right_min(rPeaks.size());
+	std::vector<bool> left_bounded(rPeaks.size()), right_bounded(rPeaks.size());
 
-	for (size_t i = 0; i < mask.size(); i++)
-		mask[i] = true;
+	std::vector<Entry> stack;
 
-	// look for nNumPeaks number of peaks
-	while (nNumPeaks--)
-	{
-		// find maximum using mask
-		auto m = find_max(vec, mask);
+	stack.reserve(n);
 
-		// skip if error
-		if (m.bError)
-			continue;
+	// scan vector from the left or from the right and record saddles at peaks
+	auto scan = [&](bool bForward, std::vector<double>& rMin, std::vector<bool>& rBounded)
+	{
+		stack.clear();
 
-		// add to list
-		peaks.emplace_back(m.nPos);
+		size_t k = bForward ? 0 : rPeaks.size();
 
-		// mask from right of peak
+		for (size_t t = 0; t < n; t++)
 		{
-			bool bHasReachedThreshold = false;
-			double fMinValue = 0;
+			size_t i = bForward ? t : n - 1 - t;
 
-			for (size_t i = m.nPos; i < vec.size(); i++)
+			Entry entry;
+
+			entry.fValue = vec[i];
+			entry.fMin = vec[i];
+			entry.nMinPos = i;
+
+			// merge all entries that are not higher
+			while (stack.size() > 0 && stack.back().fValue <= entry.fValue)
 			{
-				// threshold has been reached
-				if (!bHasReachedThreshold && vec[i] < (fThreshold * m.fValue))
+				if (stack.back().fMin < entry.fMin)
 				{
-					bHasReachedThreshold = true;
-					fMinValue = vec[i];
+					entry.fMin = stack.back().fMin;
+					entry.nMinPos = stack.back().nMinPos;
 				}
 
-				// record minimum values
-				if (bHasReachedThreshold)
-					fMinValue = min(fMinValue, vec[i]);
+				stack.pop_back();
+			}
 
-				// break if new maximum
-				if (bHasReachedThreshold && (vec[i] * fThreshold) > fMinValue)
-					break;
+			// record saddle if at a peak
+			if (bForward ? (k < rPeaks.size() && rPeaks[k].nPos == i) : (k > 0 && rPeaks[k - 1].nPos == i))
+			{
+				size_t p = bForward ? k++ : --k;
+
+				rMin[p] = entry.fMin;
+				rBounded[p] = stack.size() > 0;
 
-				// invalidate mask there
-				mask[i] = false;
+				if (bForward)
+					rPeaks[p].nLeftBase = entry.nMinPos;
+				else
+					rPeaks[p].nRightBase = entry.nMinPos;
 			}
+
+			stack.emplace_back(entry);
 		}
+	};
 
-		// mask from left of peak
-		{
-			bool bHasReachedThreshold = false;
-			double fMinValue = 0;
+	scan(true, left_min, left_bounded);
+	scan(false, right_min, right_bounded);
 
-			for (size_t i = m.nPos; i >= 0; i--)
-			{
-				// break if below threshold
-				if (!bHasReachedThreshold && vec[i] < (fThreshold * m.fValue))
-				{
-					bHasReachedThreshold = true;
-					fMinValue = vec[i];
-				}
+	for (size_t p = 0; p < rPeaks.size(); p++)
+	{
+		double fSaddle;
+
+		if (left_bounded[p] && right_bounded[p])
+			fSaddle = max(left_min[p], right_min[p]);
+		else if (left_bounded[p])
+			fSaddle = left_min[p];
+		else if (right_bounded[p])
+			fSaddle = right_min[p];
+		else
+			fSaddle = min(left_min[p], right_min[p]);
 
-				// record minimum values
-				if (bHasReachedThreshold)
-					fMinValue = min(fMinValue, vec[i]);
+		rPeaks[p].fProminence = rPeaks[p].fHeight - fSaddle;
+	}
+}
 
-				// break if new maximum
-				if (bHasReachedThreshold && (vec[i] * fThreshold) > fMinValue)
-					break;
+// return at most nNumPeaks peaks by decreasing prominence, keeping those at least fMinProminence
+static std::vector<PeakInfo> detectPeaks(const vector_t& vec, size_t nNumPeaks, double fMinProminence = 0)
+{
+	auto peaks = findLocalMaxima(vec);
 
-				// invalidate mask there
-				mask[i] = false;
+	computeProminences(vec, peaks);
 
-				// break if i is zero (DO NOT REMOVE THIS LINE OR INFINITE LOOP WILL OCCUR
-				if (i == 0)
-					break;
-			}
-		}
+	// threshold mask
+	peaks.erase(std::remove_if(peaks.begin(), peaks.end(), [&](const PeakInfo& rPeak) { return rPeak.fProminence < fMinProminence; }), peaks.end());
+
+	// top-k
+	auto by_prominence = [](const PeakInfo& a, const PeakInfo& b)
+	{
+		if (a.fProminence != b.fProminence)
+			return a.fProminence > b.fProminence;
+
+		return a.nPos < b.nPos;
+	};
+
+	if (nNumPeaks < peaks.size())
+	{
+		std::partial_sort(peaks.begin(), peaks.begin() + nNumPeaks, peaks.end(), by_prominence);
+
+		peaks.resize(nNumPeaks);
 	}
+	else
+		std::sort(peaks.begin(), peaks.end(), by_prominence);
 
-	// return vector
 	return peaks;
 }
 
-// return distance to peaks
-static double distPeaks(const vector_t& peaks, double fPos)
+// find peaks in vector, fThreshold is the fraction of its height a peak must drop below before reaching a higher one
+static std::vector<size_t> findPeaks(const vector_t& vec, size_t nNumPeaks, double fThreshold)
 {
-	// create temp vector
-	vector_t temp(peaks.size());
+	std::vector<size_t> ret;
 
-	// compute distance to all peaks
-	for (size_t i = 0; i < peaks.size(); i++)
-		temp[i] = fabs(peaks[i] - fPos);
+	// a peak is kept if its saddle is below fThreshold of its height, browsed by decreasing prominence so that
+	// the global maximum comes first and is always kept, as it has no higher point to drop towards
+	for (auto& v : detectPeaks(vec, vec.size()))
+	{
+		if (ret.size() >= nNumPeaks)
+			break;
 
-	// return minimum of all distances
-	return minof(temp);
+		if (ret.empty() || v.fHeight - v.fProminence < fThreshold * v.fHeight)
+			ret.push_back(v.nPos);
+	}
+
+	return ret;
 }
 
-// return closest peak
-static double getClosestPeak(const vector_t& peaks, double fPos)
+/*
+ *	sorted and immutable list of reference positions
+ *
+ *	Nearest lookups are a binary search whose only branch is the loop count, the comparison being turned into a
+ *	conditional move, followed by a comparison with the next position. No memory is allocated after construction,
+ *	which matters for cost functions evaluated for every peak on every simplex step.
+ */
+class PeakIndex
 {
-	// create temp vector
-	double fMinDist = 0;
-	size_t nIndex = 0;
+public:
+	PeakIndex(void) {}
 
-	// skip if null vector
-	if (peaks.size() == 0)
-		return 0;
+	PeakIndex(const vector_t& rPositions)
+	{
+		this->m_positions = rPositions;
 
-	// compute distance to all peaks
-	for (size_t i = 0; i < peaks.size(); i++)
+		std::sort(this->m_positions.begin(), this->m_positions.end());
+	}
+
+	// return number of positions
+	size_t size(void) const
 	{
-		double fDist = fabs(peaks[i] - fPos);
+		return this->m_positions.size();
+	}
 
-		if (i == 0 || fDist < fMinDist)
+	// return sorted positions
+	const vector_t& positions(void) const
+	{
+		return this->m_positions;
+	}
+
+	// return position closest to fPos, zero if empty
+	double closest(double fPos) const
+	{
+		size_t n = this->m_positions.size();
+
+		if (n == 0)
+			return 0;
+
+		// find last position not above fPos, or first position if all are above
+		const double* pBase = this->m_positions.data();
+
+		for (size_t nLength = n; nLength > 1;)
 		{
-			nIndex = i;
-			fMinDist = fDist;
+			size_t nHalf = nLength / 2;
+
+			pBase = (pBase[nHalf] <= fPos) ? pBase + nHalf : pBase;
+			nLength -= nHalf;
 		}
+
+		// compare with next position
+		const double* pNext = (pBase + 1 < this->m_positions.data() + n) ? pBase + 1 : pBase;
+
+		return (fabs(*pNext - fPos) < fabs(*pBase - fPos)) ? *pNext : *pBase;
 	}
 
-	// return peak of minimum distance
-	return peaks[nIndex];
-}
\ No newline at end of file
+	// return distance to closest position
+	double distance(double fPos) const
+	{
+		return fabs(closest(fPos) - fPos);
+	}
+
+private:
+	vector_t m_positions;
+};
+
+// return distance to peaks
+static double distPeaks(const PeakIndex& rPeaks, double fPos)
+{
+	return rPeaks.distance(fPos);
+}
+
+// return closest peak
+static double getClosestPeak(const PeakIndex& rPeaks, double fPos)
+{
+	return rPeaks.closest(fPos);
+}
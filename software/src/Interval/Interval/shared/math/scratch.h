@@ -0,0 +1,141 @@
+/*
+ *	2020 (C) The Pulsar Engineering
+ *	http://www.thepulsar.be
+ *
+ *	This document is licensed under the CERN OHL-W v2 (http://ohwr.org/cernohl).
+ *
+ *	You may redistribute and modify this document under the terms of the
+ *	CERN OHL-W v2 only. This document is distributed WITHOUT ANY EXPRESS OR
+ *	IMPLIED WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY AND
+ *	FITNESS FOR APARTICULAR PURPOSE. Please refer to the CERN OHL-W v2 for
+ *	applicable conditions.
+ */
+#pragma once
+
+#include <memory>
+#include <vector>
+
+/*
+ *	per-thread pool of temporary vectors
+ *
+ *	Buffers are borrowed from the top of a stack. A buffer released out of order, for instance by a lease that
+ *	was moved away, is only marked free and given back once every buffer above it is released too, so that
+ *	releasing never fails. Released buffers keep their capacity so that processing the same spectrum size
+ *	again does not touch the heap.
+ */
+template<typename Type> class ScratchArena
+{
+public:
+
+	// scoped buffer, given back to the arena on destruction
+	class Lease
+	{
+		friend class ScratchArena;
+
+	public:
+		Lease(const Lease&) = delete;
+		Lease& operator=(const Lease&) = delete;
+
+		Lease(Lease&& rLease) noexcept
+		{
+			this->m_pArena = rLease.m_pArena;
+			this->m_nSlot = rLease.m_nSlot;
+
+			rLease.m_pArena = nullptr;
+		}
+
+		~Lease(void)
+		{
+			if (this->m_pArena != nullptr)
+				this->m_pArena->release(this->m_nSlot);
+		}
+
+		// access vector
+		std::vector<Type>& get(void) const
+		{
+			return *this->m_pArena->m_pool[this->m_nSlot];
+		}
+
+		std::vector<Type>& operator*(void) const
+		{
+			return get();
+		}
+
+		std::vector<Type>* operator->(void) const
+		{
+			return &get();
+		}
+
+	private:
+		Lease(ScratchArena* pArena, size_t nSlot)
+		{
+			this->m_pArena = pArena;
+			this->m_nSlot = nSlot;
+		}
+
+		ScratchArena* m_pArena;
+		size_t m_nSlot;
+	};
+
+	// return arena of calling thread
+	static ScratchArena& local(void)
+	{
+		thread_local ScratchArena arena;
+
+		return arena;
+	}
+
+	// borrow a vector of 'nSize' elements, content is undefined
+	Lease borrow(size_t nSize)
+	{
+		// add a new buffer if all are in use
+		if (this->m_nUsed == this->m_pool.size())
+		{
+			this->m_pool.emplace_back(std::make_unique<std::vector<Type>>());
+			this->m_borrowed.emplace_back(false);
+		}
+
+		this->m_borrowed[this->m_nUsed] = true;
+
+		// resize does not reallocate if capacity is large enough
+		this->m_pool[this->m_nUsed]->resize(nSize);
+
+		return Lease(this, this->m_nUsed++);
+	}
+
+	// return number of buffers held, including released ones still below a borrowed one
+	size_t inUse(void) const
+	{
+		return this->m_nUsed;
+	}
+
+private:
+	ScratchArena(void)
+	{
+		this->m_nUsed = 0;
+	}
+
+	// release buffer, called from destructors so it must not throw
+	void release(size_t nSlot) noexcept
+	{
+		// ignore slots that are not borrowed
+		if (nSlot >= this->m_nUsed || !this->m_borrowed[nSlot])
+			return;
+
+		this->m_borrowed[nSlot] = false;
+
+		// give back free buffers from the top
+		while (this->m_nUsed > 0 && !this->m_borrowed[this->m_nUsed - 1])
+			this->m_nUsed--;
+	}
+
+	std::vector<std::unique_ptr<std::vector<Type>>> m_pool;
+	std::vector<bool> m_borrowed;
+	size_t m_nUsed;
+};
+
+// borrow a temporary vector from the calling thread arena
+template<typename Type = double> auto scratch(size_t nSize)
+{
+	return ScratchArena<Type>::local().borrow(nSize);
+}
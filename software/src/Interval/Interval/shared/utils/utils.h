@@ -12,6 +12,7 @@
  */
 #pragma once
 
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -31,6 +32,17 @@ inline double getTime(void)
 	return 1e-3 * (double)GetTickCount();
 }
 
+// get time from high resolution counter
+inline double getPreciseTime(void)
+{
+	LARGE_INTEGER freq, count;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+
+	return (double)count.QuadPart / (double)freq.QuadPart;
+}
+
 // randomize 64bits number
 static size_t rand64(void)
 {
@@ -120,8 +132,49 @@ template<typename Type> void myswap(Type& a, Type& b)
 	b = temp;
 }
 
+// FNV-1a style hash of a memory block working on 64-bit words, chained through seed
+static unsigned long long hash_bytes(const void* pData, size_t nSize, unsigned long long seed = 14695981039346656037ull)
+{
+	auto pBytes = (const unsigned char*)pData;
+
+	size_t i = 0;
+
+	for (; i + 8 <= nSize; i += 8)
+	{
+		unsigned long long word;
+
+		memcpy(&word, pBytes + i, 8);
+
+		seed ^= word;
+		seed *= 1099511628211ull;
+		seed ^= seed >> 29;
+	}
+
+	for (; i < nSize; i++)
+	{
+		seed ^= pBytes[i];
+		seed *= 1099511628211ull;
+	}
+
+	return seed;
+}
+
+// hash of a plain value, chained through seed
+template<typename Type> static unsigned long long hash_value(const Type& value, unsigned long long seed = 14695981039346656037ull)
+{
+	return hash_bytes(&value, sizeof(value), seed);
+}
+
+// hash of vector contents, chained through seed
+template<typename Type> static unsigned long long hash_vector(const std::vector<Type>& vec, unsigned long long seed = 14695981039346656037ull)
+{
+	seed = hash_value(vec.size(), seed);
+
+	return vec.empty() ? seed : hash_bytes(vec.data(), vec.size() * sizeof(Type), seed);
+}
+
 // return median of array
-static double median(double* pData, size_t nData)
+template<typename Type> static Type median(Type* pData, size_t nData)
 {
 	if (pData == nullptr || nData == 0)
 		return 0;
@@ -138,7 +191,7 @@ static double median(double* pData, size_t nData)
 	if ((nData % 2) == 1)
 		return pData[pivot];
 	else
-		return 0.5 * (pData[pivot] + pData[pivot + 1]);
+		return (Type)(0.5 * (pData[pivot] + pData[pivot + 1]));
 }
 
 // tokenize string
@@ -37,6 +37,7 @@
 #include "calibrate.h"
 #include "state.h"
 #include "spc.h"
+#include "worker.h"
 #include "exception.h"
 
 // main application class
@@ -70,6 +71,7 @@ public:
 		EVENT_HELP,
 		EVENT_ENABLE_ALL,
 		EVENT_DISABLE_ALL,
+		EVENT_SNAPSHOT,
 	};
 
 	// constructor
@@ -89,6 +91,10 @@ public:
 		// all components enabled by default
 		this->m_bEnable = true;
 
+		// nothing built yet
+		this->m_nPlotVersion = 0;
+		this->m_nPeaksVersion = 0;
+
 		// register events
 		listen(EVENT_CLOSE, SELF(SpectrumAnalyzerApp::onClose));
 		listen(EVENT_RENDER, SELF(SpectrumAnalyzerApp::onRender));
@@ -111,6 +117,7 @@ public:
 		listen(EVENT_HELP, SELF(SpectrumAnalyzerApp::onHelp));
 		listen(EVENT_ENABLE_ALL, SELF(SpectrumAnalyzerApp::onEnableAll));
 		listen(EVENT_DISABLE_ALL, SELF(SpectrumAnalyzerApp::onDisableAll));
+		listen(EVENT_SNAPSHOT, SELF(SpectrumAnalyzerApp::onSnapshot));
 
 		// load splash screen
 		_debug("loading splash screen");
@@ -285,6 +292,7 @@ public:
 		this->m_pParamsDialog->listen(wndParametersDialog::EVENT_AXIS, SELF(SpectrumAnalyzerApp::onAxisChange));
 		this->m_pParamsDialog->listen(wndParametersDialog::EVENT_RAMAN_WAVELENGTH, SELF(SpectrumAnalyzerApp::onRamanWavelengthChange));
 		this->m_pParamsDialog->listen(wndParametersDialog::EVENT_BASELINE, SELF(SpectrumAnalyzerApp::onBaselineChange));
+		this->m_pParamsDialog->listen(wndParametersDialog::EVENT_BASELINE_ALGORITHM, SELF(SpectrumAnalyzerApp::onBaselineChange));
 		this->m_pParamsDialog->listen(wndParametersDialog::EVENT_BLANK, SELF(SpectrumAnalyzerApp::onBlankChange));
 		this->m_pParamsDialog->listen(wndParametersDialog::EVENT_SGOLAY, SELF(SpectrumAnalyzerApp::onSGolayChange));
 		this->m_pParamsDialog->listen(wndParametersDialog::EVENT_SGOLAY_WINDOW, SELF(SpectrumAnalyzerApp::onSGolayChange));
@@ -311,6 +319,12 @@ public:
 
 		this->m_pCalibrationDialog->init();
 
+		// start plot worker
+		_debug("starting plot worker");
+
+		this->m_plotWorker.setWindow(this->m_hWnd);
+		this->m_plotWorker.start();
+
 		// register hot keys
 		RegisterHotKey(this->m_hWnd, HOTKEY_ACQ, 0, VK_F5);
 
@@ -327,6 +341,14 @@ public:
 	{
 		_debug("clearing SpectrumAnalyzerApp");
 
+		// stop plot worker before the objects it may use are released
+		try
+		{
+			if (this->m_plotWorker.isRunning())
+				this->m_plotWorker.stop();
+		}
+		catch (...) {}
+
 		// delete image list
 		if (this->m_hImageList != NULL)
 			ImageList_Destroy(this->m_hImageList);
@@ -474,8 +496,7 @@ public:
 		notify(EVENT_REDRAW);
 
 		// update peaks if any
-		if (this->m_pCalibrationDialog != nullptr)
-			this->m_pCalibrationDialog->updatePeaks();
+		updatePeaksOnNextPlot();
 
 		// update components
 		updateEnable();
@@ -525,8 +546,8 @@ public:
 		return this->m_blank.size() > 0;
 	}
 
-	// return true if blank exist
-	virtual vector_t getBlank(void) const override
+	// return blank
+	virtual const vector_t& getBlank(void) const override
 	{
 		return this->m_blank;
 	}
@@ -552,6 +573,17 @@ public:
 		return false;
 	}
 
+	// return UID of current camera
+	virtual std::string getCameraUID(void) const override
+	{
+		auto pCamera = getInstance<CameraManager>()->getCurrentCamera();
+
+		if (pCamera == nullptr)
+			throwException(NoCameraException);
+
+		return pCamera->uid();
+	}
+
 	// set camera
 	virtual void setCamera(const std::string& camera) override
 	{
@@ -807,6 +839,16 @@ public:
 	// set current plot builder
 	virtual void setPlotBuilder(std::shared_ptr<IPlotBuilder> pDataBuilder) override
 	{
+		// report processing cache efficiency of the previous builder
+		if (this->m_pPlotBuilder != nullptr)
+		{
+			auto statistics = this->m_pPlotBuilder->getCacheStatistics();
+
+			_debug("processing cache hits/misses: blank %zu/%zu, lowpass %zu/%zu, baseline %zu/%zu, sgolay %zu/%zu",
+				statistics.hits[0], statistics.misses[0], statistics.hits[1], statistics.misses[1],
+				statistics.hits[2], statistics.misses[2], statistics.hits[3], statistics.misses[3]);
+		}
+
 		this->m_pPlotBuilder = pDataBuilder;
 
 		if (this->m_pPlotBuilder != nullptr)
@@ -876,6 +918,17 @@ public:
 		return this->m_pParamsDialog->isBaselineRemovalEnabled();
 	}
 
+	// return baseline removal algorithm
+	virtual BaselineRemovalAlgorithm getBaselineAlgorithm(void) const override
+	{
+		// skip if no param dialog
+		if (this->m_pParamsDialog == nullptr)
+			return BaselineRemovalAlgorithm::Schulze;
+
+		// retrieve parameter
+		return this->m_pParamsDialog->getBaselineAlgorithm();
+	}
+
 	// return true if blank shall be removed
 	virtual bool isBlankRemovalEnabled(void) const override
 	{
@@ -1136,6 +1189,10 @@ public:
 			if (wParam == 1)
 				notify(EVENT_TIMER);
 			return true;
+
+		case WM_PLOT_SNAPSHOT:
+			notify(EVENT_SNAPSHOT);
+			return true;
 		}
 
 		return false;
@@ -1576,15 +1633,82 @@ private:
 		DestroyWindow(this->m_hWnd);
 	}
 
-	// update plot data action
+	// update plot data action, the plot is built by the worker and swapped in by onSnapshot
 	void onUpdate(void)
 	{
 		// skip if no plot builder or plot
 		if (this->m_pPlotBuilder == nullptr || this->m_pPlot == nullptr)
 			return;
 
-		// update plot data
-		this->m_pPlotBuilder->build(this->m_pPlot);
+		// build on a copy of the current plot to keep the styles set by previous builds
+		auto pPlot = std::make_shared<guiPlot>(*this->m_pPlot);
+
+		pPlot->series.clear();
+
+		this->m_plotWorker.request(this->m_pPlotBuilder, pPlot, this->m_pPlotBuilder->getAnnotations(), publishParameters());
+	}
+
+	// read processing parameters from the dialogs, every change of the dialogs ends up in an update request
+	std::shared_ptr<const ProcessingParameters> publishParameters(void)
+	{
+		auto pParams = std::make_shared<ProcessingParameters>();
+
+		pParams->bBlank = isBlankRemovalEnabled() && hasBlank();
+
+		if (pParams->bBlank)
+		{
+			// share blank with previous version if unchanged
+			if (this->m_pParameters != nullptr && this->m_pParameters->pBlank != nullptr && *this->m_pParameters->pBlank == this->m_blank)
+				pParams->pBlank = this->m_pParameters->pBlank;
+			else
+				pParams->pBlank = std::make_shared<const vector_t>(this->m_blank);
+		}
+
+		pParams->iSmoothing = getSmoothing();
+		pParams->bBaseline = isBaselineRemovalEnabled();
+		pParams->eBaselineAlgorithm = getBaselineAlgorithm();
+		pParams->bSGolay = isSGolayEnable();
+
+		if (pParams->bSGolay)
+		{
+			pParams->iSGolayWindow = getSGolayWindowSize();
+			pParams->iSGolayOrder = getSGolayOrder();
+			pParams->iSGolayDerivative = getSGolayDerivative();
+		}
+
+		pParams->eAxisType = getAxisType();
+		pParams->bCalibration = hasCalibrationData();
+
+		if (pParams->bCalibration)
+			pParams->solution = getSolution();
+
+		pParams->fRamanWavelength = getRamanWavelength();
+		pParams->bShowSaturation = isShowSaturationDataEnabled();
+
+		// keep current version if nothing changed
+		if (this->m_pParameters != nullptr && pParams->equals(*this->m_pParameters))
+			return this->m_pParameters;
+
+		pParams->version = (this->m_pParameters != nullptr) ? this->m_pParameters->version + 1 : 1;
+
+		this->m_pParameters = pParams;
+
+		return this->m_pParameters;
+	}
+
+	// display newest plot built by the worker
+	void onSnapshot(void)
+	{
+		auto snapshot = this->m_plotWorker.getSnapshot();
+
+		// skip if nothing newer than the displayed plot
+		if (snapshot.pPlot == nullptr || this->m_pPlot == nullptr || snapshot.version <= this->m_nPlotVersion)
+			return;
+
+		// copy into the displayed plot, annotations keep pointing to its axes
+		assign_plot(*this->m_pPlot, *snapshot.pPlot);
+
+		this->m_nPlotVersion = snapshot.version;
 
 		// adjust right margin
 		if (this->m_pPlot->vaxis2.render_enable)
@@ -1603,6 +1727,35 @@ private:
 			this->m_pPlot->margin.bottom = DEFAULT_MARGIN;
 		else
 			this->m_pPlot->margin.bottom = 25;
+
+		// redraw
+		notify(EVENT_REDRAW);
+
+		// run peak detection delayed until this plot
+		if (this->m_nPeaksVersion != 0 && this->m_nPlotVersion >= this->m_nPeaksVersion)
+		{
+			this->m_nPeaksVersion = 0;
+
+			if (this->m_pCalibrationDialog != nullptr)
+				this->m_pCalibrationDialog->updatePeaks();
+		}
+	}
+
+	// update peak detection once the plot requested so far is displayed
+	void updatePeaksOnNextPlot(void)
+	{
+		if (this->m_pCalibrationDialog == nullptr)
+			return;
+
+		this->m_nPeaksVersion = this->m_plotWorker.getRequestedVersion();
+
+		// plot is already up to date
+		if (this->m_nPeaksVersion <= this->m_nPlotVersion)
+		{
+			this->m_nPeaksVersion = 0;
+
+			this->m_pCalibrationDialog->updatePeaks();
+		}
 	}
 
 	// render plot action
@@ -2350,8 +2503,7 @@ private:
 		notify(EVENT_REDRAW);
 
 		// update calibration
-		if (this->m_pCalibrationDialog != nullptr)
-			this->m_pCalibrationDialog->updatePeaks();
+		updatePeaksOnNextPlot();
 	}
 
 	// change axis type
@@ -2362,8 +2514,7 @@ private:
 		notify(EVENT_REDRAW);
 
 		// update calibration
-		if (this->m_pCalibrationDialog != nullptr)
-			this->m_pCalibrationDialog->updatePeaks();
+		updatePeaksOnNextPlot();
 	}
 
 	// change raman wavelength
@@ -2382,8 +2533,7 @@ private:
 		notify(EVENT_REDRAW);
 
 		// update calibration
-		if (this->m_pCalibrationDialog != nullptr)
-			this->m_pCalibrationDialog->updatePeaks();
+		updatePeaksOnNextPlot();
 	}
 
 	// change baseline
@@ -2394,8 +2544,7 @@ private:
 		notify(EVENT_REDRAW);
 
 		// update calibration
-		if (this->m_pCalibrationDialog != nullptr)
-			this->m_pCalibrationDialog->updatePeaks();
+		updatePeaksOnNextPlot();
 	}
 
 	// sgolay was changed
@@ -2728,6 +2877,11 @@ private:
 	std::shared_ptr<guiPlot> m_pPlot;
 	std::shared_ptr<IPlotBuilder> m_pPlotBuilder;
 
+	PlotWorker m_plotWorker;
+	unsigned long long m_nPlotVersion, m_nPeaksVersion;
+
+	std::shared_ptr<const ProcessingParameters> m_pParameters;
+
     std::shared_ptr<wndParametersDialog> m_pParamsDialog;
     std::shared_ptr<wndCalibrationDialog> m_pCalibrationDialog;
 	std::shared_ptr<wndIAcquisitionDialog> m_pMultipleAcquisitionDialog;
@@ -24,6 +24,7 @@
 #include "shared/math/optfuncs.h"
 #include "shared/math/calibration.h"
 #include "shared/math/interp.h"
+#include "shared/math/peakfit.h"
 
 #include "shared/gui/dialogs.h"
 #include "shared/gui/marker.h"
@@ -46,6 +47,14 @@
 #define KEY_MINDIST				"CalibrationMinDistort"
 #define KEY_MAXDIST				"CalibrationMaxDistort"
 #define KEY_MODELTYPE			"CalibrationModel"
+#define KEY_CACHE				"CalibrationCache_"
+
+// number of previous calibrations kept per camera, and identifier of their storage
+#define CALIBRATION_CACHE_SIZE			4
+#define CALIBRATION_CACHE_TYPE			'CAL0'
+
+// number of intervals over the sensor where the uncertainty of the calibration is evaluated
+#define CALIBRATION_UNCERTAINTY_POINTS	20
 
  // calibration dialog class
 class wndCalibrationDialog : public IDialog, public SpectrumAnalyzerChild
@@ -82,6 +91,7 @@ public:
 	{
 		Linear,
 		Cubic,
+		LineMatching,
 	};
 
 	// source types
@@ -119,6 +129,9 @@ public:
 		// create static solution
 		this->m_pOptimizationThread = std::make_shared<StaticSolution>(array2vector(rSolution));
 
+		// imported solutions are not cached
+		this->m_sCameraUID.clear();
+
 		// notify solution has been found
 		notify(EVENT_SOLUTION_FOUND);
 	}
@@ -256,6 +269,10 @@ public:
 			SendMessage(getItemHandle(IDC_MODEL), CB_SETCURSEL, (WPARAM)1, (LPARAM)0);
 			break;
 
+		case Model::LineMatching:
+			SendMessage(getItemHandle(IDC_MODEL), CB_SETCURSEL, (WPARAM)2, (LPARAM)0);
+			break;
+
 		default:
 			throwException(UnknownModelException);
 		}
@@ -271,6 +288,8 @@ public:
 			setModelType(Model::Linear);
 		else if (rModel == "Cubic")
 			setModelType(Model::Cubic);
+		else if (rModel == "LineMatching")
+			setModelType(Model::LineMatching);
 		else
 			throwException(UnknownModelException);
 	}
@@ -288,6 +307,9 @@ public:
 		case 1:
 			return Model::Cubic;
 
+		case 2:
+			return Model::LineMatching;
+
 		default:
 			throwException(UnknownModelException);
 		}
@@ -445,6 +467,7 @@ public:
 
 		// clear solution
 		this->m_pOptimizationThread.reset();
+		this->m_sCameraUID.clear();
 
 		// send solution update
 		updatePeaks();
@@ -482,6 +505,7 @@ public:
 		// set model types
 		SendMessageA(getItemHandle(IDC_MODEL), CB_ADDSTRING, (WPARAM)0, (LPARAM)"Linear");
 		SendMessageA(getItemHandle(IDC_MODEL), CB_ADDSTRING, (WPARAM)0, (LPARAM)"Cubic");
+		SendMessageA(getItemHandle(IDC_MODEL), CB_ADDSTRING, (WPARAM)0, (LPARAM)"Cubic (line matching)");
 		SendMessage(getItemHandle(IDC_MODEL), CB_SETCURSEL, (WPARAM)0, (LPARAM)0);
 
 		// sensitivity
@@ -658,6 +682,10 @@ private:
 			saveString(KEY_MODELTYPE, "Cubic");
 			break;
 
+		case Model::LineMatching:
+			saveString(KEY_MODELTYPE, "LineMatching");
+			break;
+
 		default:
 			saveString(KEY_MODELTYPE, "???");
 			break;
@@ -683,6 +711,11 @@ private:
 			nMinPeaks = 3;
 			break;
 
+		// needs a triplet and at least one more peak to check it
+		case Model::LineMatching:
+			nMinPeaks = 4;
+			break;
+
 		// throw exception for unknown model
 		default:
 			throwException(UnknownModelException);
@@ -808,8 +841,8 @@ private:
 		// get calibration data
 		auto calibration_data = getCalibrationData();
 
-		// find peaks
-		auto peaks = refinePeaksPosition(x, plot_data.y, findPeaks(plot_data.y, num_peaks, fSensitivity));
+		// find peaks and fit their profiles for sub-pixel positions
+		auto peaks = fitPeaksPosition(x, plot_data.y, findPeaks(plot_data.y, num_peaks, fSensitivity), PeakProfile::PseudoVoigt);
 
 		// clear previous annotations
 		clearAnnotations();
@@ -920,6 +953,10 @@ private:
 			this->m_pOptimizationThread = std::make_shared<CubicModelThread>(this->m_detectedPeaks, calibration_data, fMinRange, fMaxRange, fMinSpan, fMaxSpan, fMinDistortion, fMaxDistortion, nNumSamples);
 			break;
 
+		case Model::LineMatching:
+			this->m_pOptimizationThread = std::make_shared<LineMatchingModelThread<4>>(this->m_detectedPeaks, calibration_data, fMinRange, fMaxRange, fMinSpan, fMaxSpan, fMinDistortion, fMaxDistortion, nNumSamples);
+			break;
+
 			// throw exception for unknown model
 		default:
 			throwException(UnknownModelException);
@@ -929,6 +966,15 @@ private:
 		if (this->m_pOptimizationThread == nullptr)
 			return;
 
+		// warm start from previous calibrations of the same camera
+		this->m_sCameraUID.clear();
+
+		if (hasCamera())
+		{
+			this->m_sCameraUID = getCameraUID();
+			this->m_pOptimizationThread->setWarmStarts(loadCalibrationCache(this->m_sCameraUID));
+		}
+
 		// start thread
 		this->m_pOptimizationThread->start();
 
@@ -1142,7 +1188,7 @@ private:
 			return;
 
 		// update progressbar
-		auto progress = (int)floor(1000.0 * (double)this->m_pOptimizationThread->getProcessedSamples() / (double)(this->m_pOptimizationThread->getMaxSamples() - 1));
+		auto progress = (int)floor(1000.0 * (double)this->m_pOptimizationThread->getProcessedSamples() / (double)max((size_t)1, this->m_pOptimizationThread->getMaxSamples()));
 
 		SendMessage(getItemHandle(IDC_CALIBRATION_PROGRESS), PBM_SETRANGE, (WPARAM)0, (LPARAM)MAKELPARAM(0, 1000));
 		SendMessage(getItemHandle(IDC_CALIBRATION_PROGRESS), PBM_SETPOS, (WPARAM)progress, (LPARAM)NULL);
@@ -1181,7 +1227,26 @@ private:
 		// display model + rms error
 		char szTmp[256];
 
-		sprintf_s(szTmp, "RMS: %.3f nm", getCalibrationModelRMS(coeffs, this->m_detectedPeaks, getCalibrationData()));
+		double fRMS = getCalibrationModelRMS(coeffs, this->m_detectedPeaks, getCalibrationData());
+
+		// add worst uncertainty of the projection over the sensor when the solution was refined
+		auto covariance = this->m_pOptimizationThread->getCovariance();
+
+		if (covariance.numRows() > 0)
+		{
+			double fUncertainty = 0;
+
+			for (size_t i = 0; i <= CALIBRATION_UNCERTAINTY_POINTS; i++)
+				fUncertainty = max(fUncertainty, getCalibrationModelUncertainty(covariance, 2.0 * (double)i / (double)CALIBRATION_UNCERTAINTY_POINTS - 1.0));
+
+			sprintf_s(szTmp, "RMS: %.3f nm, uncertainty: %.3f nm", fRMS, fUncertainty);
+		}
+		else
+			sprintf_s(szTmp, "RMS: %.3f nm", fRMS);
+
+		// tell when a previous calibration was reused
+		if (this->m_pOptimizationThread->isWarmStarted())
+			strcat_s(szTmp, " (warm start)");
 
 		SetDlgItemTextA(getWindowHandle(), IDC_SZ_CALIBRATION_STATUS, szTmp);
 	}
@@ -1192,6 +1257,9 @@ private:
 		// kill timer
 		KillTimer(getWindowHandle(), 1);
 
+		// keep solution for the next calibrations of this camera
+		updateCalibrationCache();
+
 		// update RMS
 		updateRMS();
 
@@ -1202,6 +1270,111 @@ private:
 		notify(EVENT_UPDATE);
 	}
 
+	// load previous calibrations of a camera, most recent first
+	std::vector<CalibrationWarmStart> loadCalibrationCache(const std::string& rUID) const
+	{
+		std::vector<CalibrationWarmStart> ret;
+
+		auto buffer = loadBuffer(KEY_CACHE + rUID);
+
+		if (buffer.size() == 0)
+			return ret;
+
+		try
+		{
+			StorageContainer container(CALIBRATION_CACHE_TYPE);
+			container.unpack(buffer);
+
+			for (size_t i = 0; i < CALIBRATION_CACHE_SIZE; i++)
+			{
+				auto pSolution = container.get(std::to_string(i), "solution");
+				auto pPeaks = container.get(std::to_string(i), "peaks");
+
+				if (pSolution == nullptr || pPeaks == nullptr)
+					break;
+
+				storage_vector<double> solution, peaks;
+
+				solution.pop(*pSolution);
+				peaks.pop(*pPeaks);
+
+				CalibrationWarmStart entry;
+
+				entry.coeffs = vector_t(solution.begin(), solution.end());
+				entry.peaks = vector_t(peaks.begin(), peaks.end());
+
+				ret.emplace_back(std::move(entry));
+			}
+		}
+		// start from scratch if cache is corrupted
+		catch (IException&)
+		{
+			ret.clear();
+		}
+
+		return ret;
+	}
+
+	// save previous calibrations of a camera, most recent first
+	void saveCalibrationCache(const std::string& rUID, const std::vector<CalibrationWarmStart>& rEntries)
+	{
+		StorageContainer container(CALIBRATION_CACHE_TYPE);
+
+		for (size_t i = 0; i < rEntries.size() && i < CALIBRATION_CACHE_SIZE; i++)
+		{
+			StorageObject solution_obj(std::to_string(i), "solution");
+			StorageObject peaks_obj(std::to_string(i), "peaks");
+
+			storage_vector<double> solution(rEntries[i].coeffs.begin(), rEntries[i].coeffs.end());
+			storage_vector<double> peaks(rEntries[i].peaks.begin(), rEntries[i].peaks.end());
+
+			solution.push(solution_obj);
+			peaks.push(peaks_obj);
+
+			container.emplace_back(std::move(solution_obj));
+			container.emplace_back(std::move(peaks_obj));
+		}
+
+		auto buffer = container.pack();
+
+		saveBuffer(KEY_CACHE + rUID, buffer);
+	}
+
+	// add current solution to the cache of its camera if it is reliable enough to warm start later calibrations
+	void updateCalibrationCache(void)
+	{
+		// skip imported solutions and calibrations made without camera
+		if (this->m_sCameraUID.empty() || !hasSolution())
+			return;
+
+		// a warm-started solution comes from the cache already, storing it again would fill the cache with copies
+		if (this->m_pOptimizationThread->isWarmStarted())
+			return;
+
+		auto coeffs = getSolution();
+		auto fit = refineCalibrationModel<4>(coeffs, this->m_detectedPeaks, getCalibrationData());
+
+		if (!isCalibrationFitReliable(fit, this->m_detectedPeaks.size()))
+			return;
+
+		CalibrationWarmStart entry;
+
+		entry.coeffs = array2vector(coeffs);
+		entry.peaks = this->m_detectedPeaks;
+
+		auto entries = loadCalibrationCache(this->m_sCameraUID);
+
+		entries.insert(entries.begin(), std::move(entry));
+
+		if (entries.size() > CALIBRATION_CACHE_SIZE)
+			entries.resize(CALIBRATION_CACHE_SIZE);
+
+		saveCalibrationCache(this->m_sCameraUID, entries);
+
+		// store once per calibration
+		this->m_sCameraUID.clear();
+	}
+
 	// label peaks
 	void labelPeaks(void)
 	{
@@ -1243,5 +1416,8 @@ private:
 	std::shared_ptr<IGlobalOptimizationThread> m_pOptimizationThread;
 	vector_t m_detectedPeaks;
 
+	// camera whose calibration is running, empty if solution must not be cached
+	std::string m_sCameraUID;
+
 	size_t m_nAnnotationIndex;
 };
\ No newline at end of file
@@ -48,6 +48,7 @@
 #define KEY_LOGPATH				"LogPath"
 #define KEY_RAMANWAVELENGTH		"RamanWavelength"
 #define KEY_BASELINE			"RemoveBaseline"
+#define KEY_BASELINE_ALGORITHM	"BaselineAlgorithm"
 #define KEY_SGOLAY_ENABLE		"SGolayEnable"
 #define KEY_SGOLAY_WINDOW		"SGolayWindow"
 #define KEY_SGOLAY_ORDER		"SGolayOrder"
@@ -91,6 +92,7 @@ public:
 		EVENT_SGOLAY_DERIVATIVE,
 		EVENT_LOGFORMAT,
 		EVENT_BLANK,
+		EVENT_BASELINE_ALGORITHM,
 	} events;
 
 	// return log format type
@@ -218,6 +220,58 @@ public:
 		notify(EVENT_BASELINE);
 	}
 
+	// return baseline removal algorithm
+	virtual BaselineRemovalAlgorithm getBaselineAlgorithm(void) const override
+	{
+		int iAlgorithm = (int)SendMessage(getItemHandle(IDC_BASELINE_ALGORITHM), CB_GETCURSEL, (WPARAM)0, (LPARAM)0);
+
+		switch (iAlgorithm)
+		{
+		case 0:
+			return BaselineRemovalAlgorithm::Schulze;
+
+		case 1:
+			return BaselineRemovalAlgorithm::AsLS;
+
+		case 2:
+			return BaselineRemovalAlgorithm::arPLS;
+
+		case 3:
+			return BaselineRemovalAlgorithm::airPLS;
+		}
+
+		throwException(UnknownBaselineAlgorithmException);
+	}
+
+	// set baseline removal algorithm
+	void setBaselineAlgorithm(BaselineRemovalAlgorithm eAlgorithm)
+	{
+		switch (eAlgorithm)
+		{
+		case BaselineRemovalAlgorithm::Schulze:
+			SendMessage(getItemHandle(IDC_BASELINE_ALGORITHM), CB_SETCURSEL, (WPARAM)0, (LPARAM)0);
+			break;
+
+		case BaselineRemovalAlgorithm::AsLS:
+			SendMessage(getItemHandle(IDC_BASELINE_ALGORITHM), CB_SETCURSEL, (WPARAM)1, (LPARAM)0);
+			break;
+
+		case BaselineRemovalAlgorithm::arPLS:
+			SendMessage(getItemHandle(IDC_BASELINE_ALGORITHM), CB_SETCURSEL, (WPARAM)2, (LPARAM)0);
+			break;
+
+		case BaselineRemovalAlgorithm::airPLS:
+			SendMessage(getItemHandle(IDC_BASELINE_ALGORITHM), CB_SETCURSEL, (WPARAM)3, (LPARAM)0);
+			break;
+
+		default:
+			throwException(UnknownBaselineAlgorithmException);
+		}
+
+		// notify event
+		notify(EVENT_BASELINE_ALGORITHM);
+	}
+
 	// return true if blank removal is enabled
 	virtual bool isBlankRemovalEnabled(void) const override
 	{
@@ -698,6 +752,23 @@ public:
 			setLogFormat(LogFormat::SPC);
 	}
 
+	// set default baseline removal algorithm
+	void setPreferredBaselineAlgorithm(void)
+	{
+		// get algorithm
+		auto algorithm = loadString(KEY_BASELINE_ALGORITHM, "Schulze");
+
+		// set algorithm
+		if (algorithm == "Schulze")
+			setBaselineAlgorithm(BaselineRemovalAlgorithm::Schulze);
+		else if (algorithm == "AsLS")
+			setBaselineAlgorithm(BaselineRemovalAlgorithm::AsLS);
+		else if (algorithm == "arPLS")
+			setBaselineAlgorithm(BaselineRemovalAlgorithm::arPLS);
+		else if (algorithm == "airPLS")
+			setBaselineAlgorithm(BaselineRemovalAlgorithm::airPLS);
+	}
+
 	// set default axis
 	void setPreferredAxis(void)
 	{
@@ -735,6 +806,7 @@ public:
 		listen(EVENT_AXIS, SELF(wndParametersDialog::onAxisChange));
 		listen(EVENT_LOGFORMAT, SELF(wndParametersDialog::onLogFormatChange));
 		listen(EVENT_BLANK, SELF(wndParametersDialog::onBlank));
+		listen(EVENT_BASELINE_ALGORITHM, SELF(wndParametersDialog::onBaselineAlgorithmChange));
 
 		// bind dynamic vars
 		BIND_DYNAMIC_VAR(wndParametersDialog, this->smoothing, getSmoothing, setSmoothing);
@@ -805,6 +877,14 @@ public:
 		setLogPath(loadString(KEY_LOGPATH, std::string(szPath) + std::string("\\OpenRAMAN")));
 
 		// initialize baseline removal
+		SendMessageA(getItemHandle(IDC_BASELINE_ALGORITHM), CB_ADDSTRING, (WPARAM)0, (LPARAM)"Schulze et al.");
+		SendMessageA(getItemHandle(IDC_BASELINE_ALGORITHM), CB_ADDSTRING, (WPARAM)0, (LPARAM)"Asymmetric LS (AsLS)");
+		SendMessageA(getItemHandle(IDC_BASELINE_ALGORITHM), CB_ADDSTRING, (WPARAM)0, (LPARAM)"Reweighted PLS (arPLS)");
+		SendMessageA(getItemHandle(IDC_BASELINE_ALGORITHM), CB_ADDSTRING, (WPARAM)0, (LPARAM)"Adaptive PLS (airPLS)");
+		SendMessageA(getItemHandle(IDC_BASELINE_ALGORITHM), CB_SETCURSEL, (WPARAM)0, (LPARAM)0);
+
+		setPreferredBaselineAlgorithm();
+
 		enableBaselineRemovalParam(loadBool(KEY_BASELINE, false));
 
 		// initialize sgolay sliders
@@ -896,6 +976,11 @@ private:
 					notify(EVENT_BASELINE);
 				break;
 
+			case IDC_BASELINE_ALGORITHM:
+				if (HIWORD(wParam) == CBN_SELCHANGE)
+					notify(EVENT_BASELINE_ALGORITHM);
+				break;
+
 			case IDC_MEDFILT:
 				if (HIWORD(wParam) == BN_CLICKED)
 					notify(EVENT_MEDIANFILT);
@@ -1053,6 +1138,11 @@ private:
 
 		// median filtering component
 		EnableWindow(getItemHandle(IDC_BASELINE), bEnable ? TRUE : FALSE);
+
+		// skip algorithm if checkbox is unchecked
+		bEnable &= isBaselineRemovalEnabled();
+
+		EnableWindow(getItemHandle(IDC_BASELINE_ALGORITHM), bEnable ? TRUE : FALSE);
 	}
 
 	// enable blank removal
@@ -1399,6 +1489,29 @@ private:
 		}
 	}
 
+	// baseline algorithm change action
+	void onBaselineAlgorithmChange(void)
+	{
+		switch (getBaselineAlgorithm())
+		{
+		case BaselineRemovalAlgorithm::Schulze:
+			saveString(KEY_BASELINE_ALGORITHM, "Schulze");
+			break;
+
+		case BaselineRemovalAlgorithm::AsLS:
+			saveString(KEY_BASELINE_ALGORITHM, "AsLS");
+			break;
+
+		case BaselineRemovalAlgorithm::arPLS:
+			saveString(KEY_BASELINE_ALGORITHM, "arPLS");
+			break;
+
+		case BaselineRemovalAlgorithm::airPLS:
+			saveString(KEY_BASELINE_ALGORITHM, "airPLS");
+			break;
+		}
+	}
+
 	// log format change action
 	void onLogFormatChange(void)
 	{
@@ -14,6 +14,7 @@
 
 #include <string>
 #include <memory>
+#include <mutex>
 
 #include "shared/math/vector.h"
 #include "shared/math/acc.h"
@@ -37,12 +38,16 @@ public:
     // create spectre file
     virtual SpectreFile createSpectreFile(void) const override
     {
+        AUTOLOCK(this->m_mutex);
+
         return SpectreFile(this->m_acc_data.mean(), getBlank(), this->m_uid);
     }
 
     // clear accumulators
     void clear(void)
     {
+        AUTOLOCK(this->m_mutex);
+
         this->m_acc_data.reset();
         this->m_acc_sat.reset();
         this->m_acc_roi.reset();
@@ -51,18 +56,24 @@ public:
     // add data to data accumulator
     void addSignalData(const vector_t& vec)
     {
+        AUTOLOCK(this->m_mutex);
+
         this->m_acc_data.add(vec);
     }
 
     // add data to saturation accumulator
     void addSaturationData(const vector_t& vec)
     {
+        AUTOLOCK(this->m_mutex);
+
         this->m_acc_sat.add(vec);
     }
 
     // add data to ROI accumulator
     void addROIData(const vector_t& vec)
     {
+        AUTOLOCK(this->m_mutex);
+
         this->m_acc_roi.add(vec);
     }
 
@@ -87,11 +98,13 @@ public:
     // get blank data
     virtual vector_t getBlankData(void) const override
     {
+        AUTOLOCK(this->m_mutex);
+
         return this->m_acc_data.mean();
     }
 
     // build plot
-    virtual void buildPlot(std::shared_ptr<guiPlot> pPlot) const override
+    virtual void buildPlot(std::shared_ptr<guiPlot> pPlot, const ProcessingParameters& rParams) const override
     {
         // skip if no plot
         if (pPlot == nullptr)
@@ -113,11 +126,11 @@ public:
         pPlot->series[2].render_enable = false;
 
         // set series
-        setSeries1(pPlot);
+        setSeries1(pPlot, rParams);
 
-        if (showSaturationData())
+        if (rParams.bShowSaturation)
         {
-            setSeries2(pPlot);
+            setSeries2(pPlot, rParams);
             setSeries3(pPlot);
         }
 
@@ -141,7 +154,7 @@ public:
 private:
 
     // set serie1
-    void setSeries1(std::shared_ptr<guiPlot> pPlot) const
+    void setSeries1(std::shared_ptr<guiPlot> pPlot, const ProcessingParameters& rParams) const
     {
         // always check plot even if it should be valid
         if (pPlot == nullptr)
@@ -154,14 +167,20 @@ private:
             pPlot->series[0].pVerticalAxis = &pPlot->vaxis1;
 
             // set y data
-            pPlot->series[0].y = format(this->m_acc_data.mean());
+            {
+                AUTOLOCK(this->m_mutex);
+
+                this->m_acc_data.mean(pPlot->series[0].y);
+            }
+
+            format_inplace(pPlot->series[0].y, rParams);
 
             // skip if no data
             if (pPlot->series[0].y.size() == 0)
                 break;
 
             // generate axis data
-            auto axis = genAxis(pPlot->series[0].y.size());
+            auto axis = genAxis(pPlot->series[0].y.size(), rParams);
 
             // set x data
             pPlot->series[0].x = axis.vec;
@@ -205,7 +224,7 @@ private:
     }
 
     // set serie2
-    void setSeries2(std::shared_ptr<guiPlot> pPlot) const
+    void setSeries2(std::shared_ptr<guiPlot> pPlot, const ProcessingParameters& rParams) const
     {
         // always check plot even if it should be valid
         if (pPlot == nullptr)
@@ -221,14 +240,18 @@ private:
             pPlot->series[1].line.color = RGB(255, 128, 128);
 
             // set y data
-            pPlot->series[1].y = this->m_acc_sat.mean();
+            {
+                AUTOLOCK(this->m_mutex);
+
+                pPlot->series[1].y = this->m_acc_sat.mean();
+            }
 
             // skip if no data
             if (pPlot->series[1].y.size() == 0)
                 break;
 
             // generate axis data
-            auto axis = genAxis(pPlot->series[1].y.size());
+            auto axis = genAxis(pPlot->series[1].y.size(), rParams);
 
             // set x data
             pPlot->series[1].x = axis.vec;
@@ -276,7 +299,11 @@ private:
         pPlot->series[2].line.color = RGB(128, 255, 128);
 
         // set y data
-        pPlot->series[2].y = this->m_acc_roi.mean();
+        {
+            AUTOLOCK(this->m_mutex);
+
+            pPlot->series[2].y = this->m_acc_roi.mean();
+        }
         pPlot->series[2].x = linspace(0, (double)(pPlot->series[2].y.size() - 1), pPlot->series[2].y.size());
 
         // skip if no data
@@ -296,9 +323,11 @@ private:
         pPlot->series[2].render_enable = true;
     }
 
-    // accumulator used for display
+    // accumulator used for display, filled by the UI thread and read by the plot worker
     Accumulator m_acc_data, m_acc_sat, m_acc_roi;
 
+    mutable std::mutex m_mutex;
+
     // UID of camera
     std::string m_uid;
 };
\ No newline at end of file
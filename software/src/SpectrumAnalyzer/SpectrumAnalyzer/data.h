@@ -12,11 +12,14 @@
  */
 #pragma once
 
+#include <array>
 #include <string>
 #include <memory>
+#include <mutex>
 
 #include "shared/utils/exception.h"
 #include "shared/math/vector.h"
+#include "shared/math/baseline.h"
 #include "shared/math/sgolay.h"
 #include "shared/math/acc.h"
 #include "shared/math/calibration.h"
@@ -27,15 +30,19 @@
 #include "camconfig.h"
 #include "winmain.h"
 #include "spc.h"
+#include "pipeline.h"
 #include "exception.h"
 
+// scalar type of the processing chain, accumulators and least-squares solves stay in double precision
+using processing_t = float;
+
 // IPlotBuilder interface class
 class IPlotBuilder : public SpectrumAnalyzerChild
 {
 public:
 
-    // build method
-    void build(std::shared_ptr<guiPlot> pPlot)
+    // build method, annotations and parameters are copies taken by the caller so that it can run off the UI thread
+    void build(std::shared_ptr<guiPlot> pPlot, const std::vector<guiSignal>& rAnnotations, const ProcessingParameters& rParams) const
     {
         // skip if no plot
         if (pPlot == nullptr)
@@ -45,10 +52,10 @@ public:
         pPlot->series.clear();
 
         // call virtual function
-        buildPlot(pPlot);
+        buildPlot(pPlot, rParams);
 
         // add annotations
-        pPlot->series.insert(pPlot->series.end(), this->m_annotations.begin(), this->m_annotations.end());
+        pPlot->series.insert(pPlot->series.end(), rAnnotations.begin(), rAnnotations.end());
     }
 
     // clear all annotations
@@ -74,6 +81,12 @@ public:
         return this->m_annotations[nIndex];
     }
 
+    // get copy of all annotations
+    std::vector<guiSignal> getAnnotations(void) const
+    {
+        return this->m_annotations;
+    }
+
     // export to string
     std::string toString(std::shared_ptr<guiPlot> pPlot, char cSeparator=',') const
     {
@@ -127,7 +140,7 @@ public:
     virtual SpectreFile createSpectreFile(void) const = 0;
 
     // build funnction
-    virtual void buildPlot(std::shared_ptr<guiPlot> pPlot) const = 0;
+    virtual void buildPlot(std::shared_ptr<guiPlot> pPlot, const ProcessingParameters& rParams) const = 0;
 
     // return true is saturation button should be enable
     virtual bool hasSaturationOpt(void) const = 0;
@@ -160,12 +173,6 @@ public:
         return true;
     }
 
-    // return true if showing saturation data
-    bool showSaturationData(void) const
-    {
-        return isShowSaturationDataEnabled();
-    }
-
     // automatic axis span based on vector, return false in case of failure
     bool span(guiIRenderAxis& rAxis, const vector_t& vec, double fNumMajorTicks=5.0, double fNumMinorTicks=25.0) const
     {
@@ -173,45 +180,161 @@ public:
         return span_ex(rAxis, vec, minof(vec), maxof(vec), fNumMajorTicks, fNumMinorTicks);
     }
 
-    // format data
-    vector_t format(const vector_t& vec) const
+    // format data in place, stages whose input and parameters did not change are reused from cache
+    void format_inplace(vector_t& y, const ProcessingParameters& rParams) const
     {
-        // copy vector first
-        auto y = vec;
+        AUTOLOCK(this->m_cacheMutex);
+
+        const size_t NUM_STAGES = ProcessingCache<processing_t>::NUM_STAGES;
+
+        bool bBlank = rParams.bBlank && rParams.pBlank != nullptr;
+        int iSmoothing = rParams.iSmoothing;
+        bool bBaseline = rParams.bBaseline;
+        bool bSGolay = rParams.bSGolay;
+
+        // each key chains the input data with the parameters of all stages up to that one
+        std::array<unsigned long long, NUM_STAGES> keys;
+
+        auto key = hash_vector(y);
+
+        key = hash_value(bBlank, key);
+
+        if (bBlank)
+            key = hash_vector(*rParams.pBlank, key);
+
+        keys[(size_t)ProcessingStage::Blank] = key;
+
+        key = hash_value(iSmoothing, key);
+
+        keys[(size_t)ProcessingStage::Lowpass] = key;
+
+        key = hash_value(bBaseline, key);
+
+        if (bBaseline)
+            key = hash_value(rParams.eBaselineAlgorithm, key);
 
-        // remove blank if any
-        if (isBlankRemovalEnabled() && hasBlank())
-            y -= getBlank();
+        keys[(size_t)ProcessingStage::Baseline] = key;
 
-        // apply lowpass
-        y = boxcar(y, getSmoothing());
+        key = hash_value(bSGolay, key);
 
-        // apply baseline removal if enabled
-        if (isBaselineRemovalEnabled())
+        if (bSGolay)
         {
-            try
-            {
-                y -= baseline(y, BaselineRemovalAlgorithm::Schulze);
-            }
-            catch (...) {}
+            key = hash_value(rParams.iSGolayWindow, key);
+            key = hash_value(rParams.iSGolayOrder, key);
+            key = hash_value(rParams.iSGolayDerivative, key);
         }
 
-        // apply sgolay if enabled
-        if (isSGolayEnable())
+        keys[(size_t)ProcessingStage::SGolay] = key;
+
+        // recompute stages downstream of the deepest valid one
+        int iValidStage = this->m_cache.lookup(keys);
+
+        for (size_t nStage = (size_t)(iValidStage + 1); nStage < NUM_STAGES; nStage++)
         {
-            try
+            auto& out = this->m_cache.prepare(nStage);
+
+            switch ((ProcessingStage)nStage)
             {
-                y = sgolay(y, getSGolayWindowSize(), getSGolayOrder(), getSGolayDerivative());
+            // remove blank in double precision, then move to processing precision
+            case ProcessingStage::Blank:
+                if (bBlank)
+                {
+                    auto tmp = scratch<double>(y.size());
+
+                    tmp->assign(y.begin(), y.end());
+
+                    *tmp -= *rParams.pBlank;
+
+                    convert_into(out, *tmp);
+                }
+                else
+                    convert_into(out, y);
+                break;
+
+            // apply lowpass
+            case ProcessingStage::Lowpass:
+                boxcar_into(out, this->m_cache.get(nStage - 1), iSmoothing);
+                break;
+
+            // apply baseline removal if enabled
+            case ProcessingStage::Baseline:
+                out = this->m_cache.get(nStage - 1);
+
+                if (bBaseline)
+                {
+                    try
+                    {
+                        remove_baseline_inplace(out, rParams.eBaselineAlgorithm, &this->m_baselineState);
+                    }
+                    catch (...) {}
+                }
+                break;
+
+            // apply sgolay if enabled
+            case ProcessingStage::SGolay:
+                out = this->m_cache.get(nStage - 1);
+
+                if (bSGolay)
+                {
+                    try
+                    {
+                        sgolay_inplace(out, rParams.iSGolayWindow, rParams.iSGolayOrder, rParams.iSGolayDerivative);
+                    }
+                    catch (...)
+                    {
+                        out = this->m_cache.get(nStage - 1);
+                    }
+                }
+                break;
+
+            default:
+                break;
             }
-            catch (...) {}
+
+            this->m_cache.commit(nStage, keys[nStage]);
         }
 
+        convert_into(y, this->m_cache.get(NUM_STAGES - 1));
+    }
+
+    // return hit and miss counters of the processing cache
+    ProcessingCacheStatistics getCacheStatistics(void) const
+    {
+        AUTOLOCK(this->m_cacheMutex);
+
+        return this->m_cache.getStatistics();
+    }
+
+    // reset hit and miss counters of the processing cache
+    void resetCacheStatistics(void)
+    {
+        AUTOLOCK(this->m_cacheMutex);
+
+        this->m_cache.resetStatistics();
+    }
+
+    // format data
+    vector_t format(const vector_t& vec, const ProcessingParameters& rParams) const
+    {
+        // copy vector first
+        auto y = vec;
+
+        format_inplace(y, rParams);
+
         // return output vector
         return y;
     }
 
+    // format data into output vector
+    void format_into(vector_t& rOutput, const vector_t& vec, const ProcessingParameters& rParams) const
+    {
+        rOutput.assign(vec.begin(), vec.end());
+
+        format_inplace(rOutput, rParams);
+    }
+
     // generate axis data
-    auto genAxis(size_t n) const
+    auto genAxis(size_t n, const ProcessingParameters& rParams) const
     {
         // return struct
         struct
@@ -224,13 +347,15 @@ public:
         } ret;
 
         // get axis type
-        auto eAxisType = getAxisType();
+        auto eAxisType = rParams.eAxisType;
 
-        if (!hasCalibrationData())
+        if (!rParams.bCalibration)
             eAxisType = AxisType::Pixels;
 
-        // resize output vector
-        ret.vec.resize(n);
+        // get axis vector, only regenerated if size or settings changed
+        auto pAxis = getAxisData(n, eAxisType, rParams);
+
+        ret.vec = pAxis->vec;
 
         // dispatch axis type
         switch (eAxisType)
@@ -240,13 +365,9 @@ public:
             // set title
             ret.title = AXIS_WAVELENGTHS;
 
-            // generate axis vector
-            for (size_t i = 0; i < n; i++)
-                ret.vec[i] = index2wavelength(getSolution(), 2 * (double)i / (double)(n - 1) - 1);
-
             // set minimum and maximum
-            ret.fMin = minof(ret.vec);
-            ret.fMax = maxof(ret.vec);
+            ret.fMin = pAxis->fMin;
+            ret.fMax = pAxis->fMax;
 
             // display formula for labels
             ret.format = [](double val)
@@ -264,10 +385,6 @@ public:
             // set title
             ret.title = AXIS_RAMANSHIFTS;
 
-            // generate axis vector
-            for (size_t i = 0; i < n; i++)
-                ret.vec[i] = 1e7 * (1 / getRamanWavelength() - 1 / index2wavelength(getSolution(), 2 * (double)i / (double)(n - 1) - 1));
-
             // set minimum and maximum, specific case for Raman spectroscopy
             ret.fMin = 3500;
             ret.fMax = 500;
@@ -289,13 +406,9 @@ public:
             // set title
             ret.title = AXIS_PIXELS;
 
-            // generate axis vector
-            for (size_t i = 0; i < n; i++)
-                ret.vec[i] = (double)i;
-
             // set minimum and maximum
-            ret.fMin = minof(ret.vec);
-            ret.fMax = maxof(ret.vec);
+            ret.fMin = pAxis->fMin;
+            ret.fMax = pAxis->fMax;
 
             // display formula for labels
             ret.format = [](double val)
@@ -313,5 +426,69 @@ public:
     }
 
 private:
+    // return axis vector of given type, from cache if generated with the same size and settings
+    std::shared_ptr<const AxisData> getAxisData(size_t n, AxisType eAxisType, const ProcessingParameters& rParams) const
+    {
+        auto pAxis = std::make_shared<AxisData>();
+
+        pAxis->nSize = n;
+        pAxis->eAxisType = eAxisType;
+        pAxis->solution.fill(0);
+        pAxis->fRamanWavelength = 0;
+
+        // only keep settings the axis depends on
+        if (eAxisType != AxisType::Pixels)
+            pAxis->solution = rParams.solution;
+
+        if (eAxisType == AxisType::RamanShifts)
+            pAxis->fRamanWavelength = rParams.fRamanWavelength;
+
+        AUTOLOCK(this->m_axisMutex);
+
+        if (this->m_pAxis != nullptr && this->m_pAxis->matches(*pAxis))
+            return this->m_pAxis;
+
+        // generate axis vector
+        switch (eAxisType)
+        {
+        case AxisType::Wavelengths:
+            index2wavelength_into(pAxis->vec, pAxis->solution, n);
+            break;
+
+        case AxisType::RamanShifts:
+            index2wavelength_into(pAxis->vec, pAxis->solution, n);
+
+            for (auto& v : pAxis->vec)
+                v = 1e7 * (1 / pAxis->fRamanWavelength - 1 / v);
+            break;
+
+        default:
+        case AxisType::Pixels:
+            pAxis->vec.resize(n);
+
+            for (size_t i = 0; i < n; i++)
+                pAxis->vec[i] = (double)i;
+            break;
+        }
+
+        pAxis->fMin = minof(pAxis->vec);
+        pAxis->fMax = maxof(pAxis->vec);
+
+        this->m_pAxis = pAxis;
+
+        return pAxis;
+    }
+
     std::vector<guiSignal> m_annotations;
+
+    // previous frame of the baseline removal, updated by the formatting chain
+    mutable BaselineState m_baselineState;
+
+    // memoized outputs of the formatting chain
+    mutable ProcessingCache<processing_t> m_cache;
+    mutable std::mutex m_cacheMutex;
+
+    // last generated horizontal axis
+    mutable std::shared_ptr<const AxisData> m_pAxis;
+    mutable std::mutex m_axisMutex;
 };
@@ -196,6 +196,16 @@ public:
     }
 };
 
+// UnknownBaselineAlgorithmException exception class
+class UnknownBaselineAlgorithmException : public IException
+{
+public:
+    virtual std::string toString(void) const override
+    {
+        return "Unknown baseline removal algorithm!";
+    }
+};
+
 // UnknownLogFormatException exception class
 class UnknownLogFormatException : public IException
 {
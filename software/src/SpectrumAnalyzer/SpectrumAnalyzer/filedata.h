@@ -67,7 +67,7 @@ public:
     }
 
     // update plot
-    virtual void buildPlot(std::shared_ptr<guiPlot> pPlot) const override
+    virtual void buildPlot(std::shared_ptr<guiPlot> pPlot, const ProcessingParameters& rParams) const override
     {
         // skip if no plot
         if (pPlot == nullptr)
@@ -93,10 +93,10 @@ public:
             pPlot->series[0].pVerticalAxis = &pPlot->vaxis1;
 
             // set y data
-            pPlot->series[0].y = format(this->m_data);
+            format_into(pPlot->series[0].y, this->m_data, rParams);
 
             // generate axis data
-            auto axis = genAxis(pPlot->series[0].y.size());
+            auto axis = genAxis(pPlot->series[0].y.size(), rParams);
 
             // set x data
             pPlot->series[0].x = axis.vec;
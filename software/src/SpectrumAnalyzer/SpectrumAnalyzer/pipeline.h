@@ -0,0 +1,229 @@
+/*
+ *	2020 (C) The Pulsar Engineering
+ *	http://www.thepulsar.be
+ *
+ *	This document is licensed under the CERN OHL-W v2 (http://ohwr.org/cernohl).
+ *
+ *	You may redistribute and modify this document under the terms of the
+ *	CERN OHL-W v2 only. This document is distributed WITHOUT ANY EXPRESS OR
+ *	IMPLIED WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY AND
+ *	FITNESS FOR APARTICULAR PURPOSE. Please refer to the CERN OHL-W v2 for
+ *	applicable conditions.
+ */
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "shared/math/vector.h"
+#include "shared/math/baseline.h"
+
+#include "state.h"
+
+// stages of the processing chain, each one consumes the output of the previous one
+enum class ProcessingStage
+{
+    Blank,
+    Lowpass,
+    Baseline,
+    SGolay,
+
+    Count,
+};
+
+/*
+ *  settings of the processing chain and of the axis generation
+ *
+ *  Filled from the dialogs on the UI thread and never modified afterwards, so that builders running on the
+ *  plot worker do not touch any window. The blank is shared between versions instead of being copied.
+ */
+struct ProcessingParameters
+{
+    ProcessingParameters(void)
+    {
+        this->version = 0;
+
+        this->bBlank = false;
+        this->iSmoothing = 1;
+        this->bBaseline = false;
+        this->eBaselineAlgorithm = BaselineRemovalAlgorithm::Schulze;
+        this->bSGolay = false;
+        this->iSGolayWindow = 0;
+        this->iSGolayOrder = 0;
+        this->iSGolayDerivative = 0;
+
+        this->eAxisType = AxisType::Pixels;
+        this->bCalibration = false;
+        this->solution.fill(0);
+        this->fRamanWavelength = 0;
+
+        this->bShowSaturation = false;
+    }
+
+    // return true if both hold the same settings, version aside
+    bool equals(const ProcessingParameters& rOther) const
+    {
+        if (this->bBlank != rOther.bBlank)
+            return false;
+
+        if (this->bBlank && this->pBlank != rOther.pBlank && (this->pBlank == nullptr || rOther.pBlank == nullptr || *this->pBlank != *rOther.pBlank))
+            return false;
+
+        return this->iSmoothing == rOther.iSmoothing &&
+            this->bBaseline == rOther.bBaseline &&
+            this->eBaselineAlgorithm == rOther.eBaselineAlgorithm &&
+            this->bSGolay == rOther.bSGolay &&
+            this->iSGolayWindow == rOther.iSGolayWindow &&
+            this->iSGolayOrder == rOther.iSGolayOrder &&
+            this->iSGolayDerivative == rOther.iSGolayDerivative &&
+            this->eAxisType == rOther.eAxisType &&
+            this->bCalibration == rOther.bCalibration &&
+            this->solution == rOther.solution &&
+            this->fRamanWavelength == rOther.fRamanWavelength &&
+            this->bShowSaturation == rOther.bShowSaturation;
+    }
+
+    unsigned long long version;
+
+    // blank removal, blank is only set if enabled and available
+    bool bBlank;
+    std::shared_ptr<const vector_t> pBlank;
+
+    // lowpass
+    int iSmoothing;
+
+    // baseline removal
+    bool bBaseline;
+    BaselineRemovalAlgorithm eBaselineAlgorithm;
+
+    // Savitzky-Golay filter
+    bool bSGolay;
+    int iSGolayWindow, iSGolayOrder, iSGolayDerivative;
+
+    // horizontal axis, solution is only relevant with calibration data
+    AxisType eAxisType;
+    bool bCalibration;
+    std::array<double, 4> solution;
+    double fRamanWavelength;
+
+    // display
+    bool bShowSaturation;
+};
+
+// horizontal axis vector with the settings it was generated from
+struct AxisData
+{
+    // return true if generated from the same size and settings
+    bool matches(const AxisData& rOther) const
+    {
+        return this->nSize == rOther.nSize && this->eAxisType == rOther.eAxisType && this->solution == rOther.solution && this->fRamanWavelength == rOther.fRamanWavelength;
+    }
+
+    size_t nSize;
+    AxisType eAxisType;
+    std::array<double, 4> solution;
+    double fRamanWavelength;
+
+    double fMin, fMax;
+    vector_t vec;
+};
+
+// hit and miss counters of the stage cache
+struct ProcessingCacheStatistics
+{
+    std::array<size_t, (size_t)ProcessingStage::Count> hits;
+    std::array<size_t, (size_t)ProcessingStage::Count> misses;
+};
+
+/*
+ *  memoized outputs of the processing chain
+ *
+ *  Every stage is stored with a key chaining the input data and the parameters of that stage and all
+ *  previous ones. A lookup returns the deepest stage whose key still matches, so that changing a parameter
+ *  only recomputes the stages downstream of it and a redraw with unchanged data recomputes nothing.
+ */
+template<typename Type> class ProcessingCache
+{
+public:
+    static const size_t NUM_STAGES = (size_t)ProcessingStage::Count;
+
+    ProcessingCache(void)
+    {
+        clear();
+        resetStatistics();
+    }
+
+    // invalidate all stages
+    void clear(void)
+    {
+        for (auto& stage : this->m_stages)
+            stage.bValid = false;
+    }
+
+    // return index of deepest stage matching its key, or -1 if none
+    int lookup(const std::array<unsigned long long, NUM_STAGES>& keys)
+    {
+        int iStage = (int)NUM_STAGES;
+
+        while (iStage-- > 0)
+        {
+            if (this->m_stages[iStage].bValid && this->m_stages[iStage].key == keys[iStage])
+            {
+                this->m_statistics.hits[iStage]++;
+                break;
+            }
+        }
+
+        // every stage after the match has to be recomputed
+        for (size_t i = (size_t)(iStage + 1); i < NUM_STAGES; i++)
+            this->m_statistics.misses[i]++;
+
+        return iStage;
+    }
+
+    // return output of a stage
+    const std::vector<Type>& get(size_t nStage) const
+    {
+        return this->m_stages[nStage].data;
+    }
+
+    // return output vector of a stage to fill, the stage stays invalid until committed
+    std::vector<Type>& prepare(size_t nStage)
+    {
+        this->m_stages[nStage].bValid = false;
+
+        return this->m_stages[nStage].data;
+    }
+
+    // mark output of a stage as valid for given key
+    void commit(size_t nStage, unsigned long long key)
+    {
+        this->m_stages[nStage].key = key;
+        this->m_stages[nStage].bValid = true;
+    }
+
+    // return statistics
+    const ProcessingCacheStatistics& getStatistics(void) const
+    {
+        return this->m_statistics;
+    }
+
+    // reset statistics
+    void resetStatistics(void)
+    {
+        this->m_statistics.hits.fill(0);
+        this->m_statistics.misses.fill(0);
+    }
+
+private:
+    struct
+    {
+        unsigned long long key;
+        bool bValid;
+
+        std::vector<Type> data;
+    } m_stages[NUM_STAGES];
+
+    ProcessingCacheStatistics m_statistics;
+};
@@ -102,6 +102,7 @@
 #define IDC_SZ_SAMPLING_VAL             1065
 #define IDC_CALIBRATION_PROGRESS        1066
 #define IDC_UPLOAD_CALIBRATION          1069
+#define IDC_BASELINE_ALGORITHM          1070
 
 // Next default values for new objects
 // 
@@ -109,7 +110,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        117
 #define _APS_NEXT_COMMAND_VALUE         40001
-#define _APS_NEXT_CONTROL_VALUE         1069
+#define _APS_NEXT_CONTROL_VALUE         1071
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif
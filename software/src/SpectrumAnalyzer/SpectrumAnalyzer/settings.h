@@ -13,6 +13,7 @@
 #pragma once
 
 #include "shared/storage/registry.h"
+#include "shared/storage/storage_buffer.h"
 
 #define REGISTRY_KEY        "Software\\OpenRAMAN\\SpectrumAnalyzer"
 
@@ -49,6 +50,18 @@ static std::string loadString(const std::string& rName, const std::string &rDefa
     return rDefault;
 }
 
+// load settings from registry, empty buffer if not found
+static StorageBuffer loadBuffer(const std::string& rName)
+{
+    try
+    {
+        return loadBufferFromRegistry(RegistryRootKey::CurrentUser, REGISTRY_KEY, rName.c_str());
+    }
+    catch (...) {}
+
+    return StorageBuffer();
+}
+
 // save settings to registry
 static bool saveInt(const std::string& rName, unsigned long ulData)
 {
@@ -65,4 +78,10 @@ static bool saveBool(const std::string& rName, bool bData)
 static bool saveString(const std::string& rName, const std::string &rData)
 {
     return saveStringToRegistry(RegistryRootKey::CurrentUser, REGISTRY_KEY, rName, rData);
+}
+
+// save settings to registry
+static bool saveBuffer(const std::string& rName, StorageBuffer& rBuffer)
+{
+    return saveDataToRegistry(RegistryRootKey::CurrentUser, REGISTRY_KEY, rName, rBuffer.data(), rBuffer.size());
 }
\ No newline at end of file
@@ -0,0 +1,479 @@
+/*
+ *	2020 (C) The Pulsar Engineering
+ *	http://www.thepulsar.be
+ *
+ *	This document is licensed under the CERN OHL-W v2 (http://ohwr.org/cernohl).
+ *
+ *	You may redistribute and modify this document under the terms of the
+ *	CERN OHL-W v2 only. This document is distributed WITHOUT ANY EXPRESS OR
+ *	IMPLIED WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY AND
+ *	FITNESS FOR APARTICULAR PURPOSE. Please refer to the CERN OHL-W v2 for
+ *	applicable conditions.
+ */
+#pragma once
+
+#include <math.h>
+
+#include <complex>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "../utils/utils.h"
+#include "../utils/exception.h"
+
+#include "scratch.h"
+
+// complex type used by the transforms
+using complex_t = std::complex<double>;
+
+// InvalidFFTSizeException class
+class InvalidFFTSizeException : public IException
+{
+public:
+	InvalidFFTSizeException(size_t nSize)
+	{
+		this->m_nSize = nSize;
+	}
+
+	virtual std::string toString(void) const override
+	{
+		char szTmp[256];
+
+		sprintf_s(szTmp, "Invalid FFT size %zu!", this->m_nSize);
+
+		return std::string(szTmp);
+	}
+
+private:
+	size_t m_nSize;
+};
+
+/*
+ *	mixed-radix complex FFT plan
+ *
+ *	The size is factored into radix 4, 2, 3, 5... stages. Twiddles are computed once per plan and the
+ *	transform is a recursive decimation in time. Inverse transforms are not normalized.
+ */
+class FFTPlan
+{
+public:
+	FFTPlan(size_t nSize, bool bInverse)
+	{
+		if (nSize == 0)
+			throwException(InvalidFFTSizeException, nSize);
+
+		this->m_nSize = nSize;
+		this->m_bInverse = bInverse;
+
+		// compute twiddles
+		this->m_twiddles.resize(nSize);
+
+		const double pi = 3.14159265358979323846;
+
+		for (size_t i = 0; i < nSize; i++)
+		{
+			double fPhase = (bInverse ? 2.0 : -2.0) * pi * (double)i / (double)nSize;
+
+			this->m_twiddles[i] = complex_t(cos(fPhase), sin(fPhase));
+		}
+
+		// factor size, radix 4 first, then 2 and odd numbers
+		size_t n = nSize;
+		size_t p = 4;
+		size_t nSqrt = (size_t)floor(sqrt((double)n));
+
+		do
+		{
+			while (n % p != 0)
+			{
+				switch (p)
+				{
+				case 4: p = 2; break;
+				case 2: p = 3; break;
+				default: p += 2; break;
+				}
+
+				if (p > nSqrt)
+					p = n;
+			}
+
+			n /= p;
+
+			this->m_factors.push_back(p);
+			this->m_factors.push_back(n);
+
+			// generic butterfly needs one temporary per radix element
+			if (p > this->m_scratch.size())
+				this->m_scratch.resize(p);
+
+		} while (n > 1);
+	}
+
+	// return transform size
+	size_t size(void) const
+	{
+		return this->m_nSize;
+	}
+
+	// return true if plan computes inverse transform
+	bool isInverse(void) const
+	{
+		return this->m_bInverse;
+	}
+
+	// compute transform of 'size()' elements, input and output must not overlap
+	void execute(const complex_t* pInput, complex_t* pOutput) const
+	{
+		work(pOutput, pInput, 1, this->m_factors.data());
+	}
+
+private:
+
+	// recursive stage
+	void work(complex_t* pOut, const complex_t* pIn, size_t nStride, const size_t* pFactors) const
+	{
+		size_t p = pFactors[0];
+		size_t m = pFactors[1];
+
+		complex_t* pBegin = pOut;
+		complex_t* pEnd = pOut + p * m;
+
+		if (m == 1)
+		{
+			do
+			{
+				*pOut = *pIn;
+				pIn += nStride;
+			} while (++pOut != pEnd);
+		}
+		else
+		{
+			do
+			{
+				work(pOut, pIn, nStride * p, pFactors + 2);
+				pIn += nStride;
+			} while ((pOut += m) != pEnd);
+		}
+
+		// recombine the p sub-transforms of size m
+		switch (p)
+		{
+		case 2: butterfly2(pBegin, nStride, m); break;
+		case 3: butterfly3(pBegin, nStride, m); break;
+		case 4: butterfly4(pBegin, nStride, m); break;
+		default: butterfly(pBegin, nStride, p, m); break;
+		}
+	}
+
+	// radix 2 butterfly
+	void butterfly2(complex_t* pOut, size_t nStride, size_t m) const
+	{
+		complex_t* pOut2 = pOut + m;
+
+		for (size_t k = 0; k < m; k++)
+		{
+			complex_t t = pOut2[k] * this->m_twiddles[k * nStride];
+
+			pOut2[k] = pOut[k] - t;
+			pOut[k] += t;
+		}
+	}
+
+	// radix 3 butterfly
+	void butterfly3(complex_t* pOut, size_t nStride, size_t m) const
+	{
+		// imaginary part of exp(-+2 pi i / 3)
+		double fSin = this->m_twiddles[nStride * m].imag();
+
+		for (size_t k = 0; k < m; k++)
+		{
+			complex_t s1 = pOut[k + m] * this->m_twiddles[k * nStride];
+			complex_t s2 = pOut[k + 2 * m] * this->m_twiddles[2 * k * nStride];
+
+			complex_t s3 = s1 + s2;
+			complex_t s0 = (s1 - s2) * fSin;
+
+			complex_t t = pOut[k] - 0.5 * s3;
+
+			pOut[k] += s3;
+			pOut[k + m] = complex_t(t.real() - s0.imag(), t.imag() + s0.real());
+			pOut[k + 2 * m] = complex_t(t.real() + s0.imag(), t.imag() - s0.real());
+		}
+	}
+
+	// radix 4 butterfly
+	void butterfly4(complex_t* pOut, size_t nStride, size_t m) const
+	{
+		for (size_t k = 0; k < m; k++)
+		{
+			complex_t s0 = pOut[k + m] * this->m_twiddles[k * nStride];
+			complex_t s1 = pOut[k + 2 * m] * this->m_twiddles[2 * k * nStride];
+			complex_t s2 = pOut[k + 3 * m] * this->m_twiddles[3 * k * nStride];
+
+			complex_t s5 = pOut[k] - s1;
+			pOut[k] += s1;
+
+			complex_t s3 = s0 + s2;
+			complex_t s4 = s0 - s2;
+
+			pOut[k + 2 * m] = pOut[k] - s3;
+			pOut[k] += s3;
+
+			// multiply s4 by -i (forward) or +i (inverse)
+			if (this->m_bInverse)
+			{
+				pOut[k + m] = complex_t(s5.real() - s4.imag(), s5.imag() + s4.real());
+				pOut[k + 3 * m] = complex_t(s5.real() + s4.imag(), s5.imag() - s4.real());
+			}
+			else
+			{
+				pOut[k + m] = complex_t(s5.real() + s4.imag(), s5.imag() - s4.real());
+				pOut[k + 3 * m] = complex_t(s5.real() - s4.imag(), s5.imag() + s4.real());
+			}
+		}
+	}
+
+	// generic radix butterfly, O(p^2)
+	void butterfly(complex_t* pOut, size_t nStride, size_t p, size_t m) const
+	{
+		complex_t* pScratch = this->m_scratch.data();
+
+		for (size_t u = 0; u < m; u++)
+		{
+			for (size_t q = 0, k = u; q < p; q++, k += m)
+				pScratch[q] = pOut[k];
+
+			for (size_t q = 0, k = u; q < p; q++, k += m)
+			{
+				size_t nTwiddle = 0;
+
+				pOut[k] = pScratch[0];
+
+				for (size_t r = 1; r < p; r++)
+				{
+					nTwiddle += nStride * k;
+
+					if (nTwiddle >= this->m_nSize)
+						nTwiddle %= this->m_nSize;
+
+					pOut[k] += pScratch[r] * this->m_twiddles[nTwiddle];
+				}
+			}
+		}
+	}
+
+	size_t m_nSize;
+	bool m_bInverse;
+
+	std::vector<complex_t> m_twiddles;
+	std::vector<size_t> m_factors;
+
+	mutable std::vector<complex_t> m_scratch;
+};
+
+/*
+ *	real-input FFT plan
+ *
+ *	A real signal of even size n is packed into n/2 complex values, transformed with a complex plan of
+ *	half size and split back into the n/2+1 non-redundant bins.
+ */
+class RealFFTPlan
+{
+public:
+	RealFFTPlan(size_t nSize) : m_forward(max(nSize >> 1, (size_t)1), false), m_inverse(max(nSize >> 1, (size_t)1), true)
+	{
+		if (nSize == 0 || (nSize % 2) != 0)
+			throwException(InvalidFFTSizeException, nSize);
+
+		this->m_nSize = nSize;
+
+		// split twiddles exp(-2 pi i k / n)
+		const double pi = 3.14159265358979323846;
+
+		this->m_twiddles.resize(nSize >> 1);
+
+		for (size_t k = 0; k < this->m_twiddles.size(); k++)
+		{
+			double fPhase = -2.0 * pi * (double)k / (double)nSize;
+
+			this->m_twiddles[k] = complex_t(cos(fPhase), sin(fPhase));
+		}
+	}
+
+	// return transform size
+	size_t size(void) const
+	{
+		return this->m_nSize;
+	}
+
+	// forward transform of 'size()' real values into 'size()/2+1' bins
+	void forward(const double* pInput, complex_t* pOutput) const
+	{
+		size_t m = this->m_nSize >> 1;
+
+		auto packed = scratch<complex_t>(m);
+		auto spectrum = scratch<complex_t>(m);
+
+		for (size_t k = 0; k < m; k++)
+			(*packed)[k] = complex_t(pInput[2 * k], pInput[2 * k + 1]);
+
+		this->m_forward.execute(packed->data(), spectrum->data());
+
+		auto& Z = *spectrum;
+
+		// split even and odd transforms
+		for (size_t k = 0; k <= m; k++)
+		{
+			complex_t zk = Z[k % m];
+			complex_t zc = std::conj(Z[(m - k) % m]);
+
+			complex_t fe = 0.5 * (zk + zc);
+			complex_t fo = complex_t(0, -0.5) * (zk - zc);
+
+			pOutput[k] = fe + twiddle(k) * fo;
+		}
+	}
+
+	// inverse transform of 'size()/2+1' bins into 'size()' real values, normalized
+	void inverse(const complex_t* pInput, double* pOutput) const
+	{
+		size_t m = this->m_nSize >> 1;
+
+		auto spectrum = scratch<complex_t>(m);
+		auto packed = scratch<complex_t>(m);
+
+		// merge even and odd transforms
+		for (size_t k = 0; k < m; k++)
+		{
+			complex_t xk = pInput[k];
+			complex_t xc = std::conj(pInput[m - k]);
+
+			complex_t fe = 0.5 * (xk + xc);
+			complex_t fo = 0.5 * (xk - xc) * std::conj(twiddle(k));
+
+			(*spectrum)[k] = fe + complex_t(0, 1) * fo;
+		}
+
+		this->m_inverse.execute(spectrum->data(), packed->data());
+
+		double fNorm = 1.0 / (double)m;
+
+		for (size_t k = 0; k < m; k++)
+		{
+			pOutput[2 * k] = fNorm * (*packed)[k].real();
+			pOutput[2 * k + 1] = fNorm * (*packed)[k].imag();
+		}
+	}
+
+private:
+
+	// exp(-2 pi i k / n) for k in [0, n/2]
+	complex_t twiddle(size_t k) const
+	{
+		if (k < this->m_twiddles.size())
+			return this->m_twiddles[k];
+
+		return complex_t(-1, 0);
+	}
+
+	size_t m_nSize;
+
+	FFTPlan m_forward, m_inverse;
+
+	std::vector<complex_t> m_twiddles;
+};
+
+// return complex plan from the calling thread cache
+static const FFTPlan& fft_plan(size_t nSize, bool bInverse = false)
+{
+	thread_local std::map<std::pair<size_t, bool>, std::unique_ptr<FFTPlan>> cache;
+
+	auto& pPlan = cache[std::make_pair(nSize, bInverse)];
+
+	if (pPlan == nullptr)
+		pPlan = std::make_unique<FFTPlan>(nSize, bInverse);
+
+	return *pPlan;
+}
+
+// return real plan from the calling thread cache
+static const RealFFTPlan& rfft_plan(size_t nSize)
+{
+	thread_local std::map<size_t, std::unique_ptr<RealFFTPlan>> cache;
+
+	auto& pPlan = cache[nSize];
+
+	if (pPlan == nullptr)
+		pPlan = std::make_unique<RealFFTPlan>(nSize);
+
+	return *pPlan;
+}
+
+// return smallest even size >= nSize whose only prime factors are 2, 3 and 5
+static size_t fft_size(size_t nSize)
+{
+	size_t n = max(nSize, (size_t)2);
+
+	for (;; n++)
+	{
+		if (n % 2 != 0)
+			continue;
+
+		size_t r = n;
+
+		while (r % 2 == 0) r /= 2;
+		while (r % 3 == 0) r /= 3;
+		while (r % 5 == 0) r /= 5;
+
+		if (r == 1)
+			return n;
+	}
+}
+
+// forward complex FFT
+static std::vector<complex_t> fft(const std::vector<complex_t>& rInput)
+{
+	std::vector<complex_t> ret(rInput.size());
+
+	fft_plan(rInput.size(), false).execute(rInput.data(), ret.data());
+
+	return ret;
+}
+
+// inverse complex FFT, normalized
+static std::vector<complex_t> ifft(const std::vector<complex_t>& rInput)
+{
+	std::vector<complex_t> ret(rInput.size());
+
+	fft_plan(rInput.size(), true).execute(rInput.data(), ret.data());
+
+	for (auto& v : ret)
+		v /= (double)rInput.size();
+
+	return ret;
+}
+
+// forward real FFT, returns n/2+1 bins
+static std::vector<complex_t> rfft(const std::vector<double>& rInput)
+{
+	std::vector<complex_t> ret((rInput.size() >> 1) + 1);
+
+	rfft_plan(rInput.size()).forward(rInput.data(), ret.data());
+
+	return ret;
+}
+
+// inverse real FFT of n/2+1 bins into n values
+static std::vector<double> irfft(const std::vector<complex_t>& rInput, size_t nSize)
+{
+	if (rInput.size() != (nSize >> 1) + 1)
+		throwException(InvalidFFTSizeException, nSize);
+
+	std::vector<double> ret(nSize);
+
+	rfft_plan(nSize).inverse(rInput.data(), ret.data());
+
+	return ret;
+}
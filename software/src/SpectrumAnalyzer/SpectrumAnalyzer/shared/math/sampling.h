@@ -0,0 +1,128 @@
+/*
+ *	2020 (C) The Pulsar Engineering
+ *	http://www.thepulsar.be
+ *
+ *	This document is licensed under the CERN OHL-W v2 (http://ohwr.org/cernohl).
+ *
+ *	You may redistribute and modify this document under the terms of the
+ *	CERN OHL-W v2 only. This document is distributed WITHOUT ANY EXPRESS OR
+ *	IMPLIED WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY AND
+ *	FITNESS FOR APARTICULAR PURPOSE. Please refer to the CERN OHL-W v2 for
+ *	applicable conditions.
+ */
+#pragma once
+
+#include <array>
+#include <random>
+
+// number of bits of the sequence, and so maximum number of distinct points is 2^32
+#define SOBOL_BITS				32
+
+// number of dimensions with direction numbers
+#define SOBOL_MAX_DIMENSIONS	10
+
+// primitive polynomials and initial direction numbers from S. Joe and F. Kuo, "Constructing Sobol sequences with better two-dimensional projections", dimension 0 is the van der Corput sequence
+static const unsigned int sobol_degree[SOBOL_MAX_DIMENSIONS] = { 0, 1, 2, 3, 3, 4, 4, 5, 5, 5 };
+static const unsigned int sobol_coeffs[SOBOL_MAX_DIMENSIONS] = { 0, 0, 1, 1, 2, 1, 4, 2, 4, 7 };
+static const unsigned int sobol_init[SOBOL_MAX_DIMENSIONS][5] =
+{
+	{ 0, 0, 0, 0, 0 },
+	{ 1, 0, 0, 0, 0 },
+	{ 1, 3, 0, 0, 0 },
+	{ 1, 3, 1, 0, 0 },
+	{ 1, 1, 1, 0, 0 },
+	{ 1, 1, 3, 3, 0 },
+	{ 1, 3, 5, 13, 0 },
+	{ 1, 1, 5, 5, 17 },
+	{ 1, 1, 5, 5, 5 },
+	{ 1, 1, 7, 11, 19 },
+};
+
+/*
+ *	Sobol low-discrepancy sequence in [0, 1)^N
+ *
+ *	Points are computed from their index through the Gray code, so that any thread can draw any point without sharing
+ *	state and a search gives the same starts whatever the scheduling. Scrambling applies a random digital shift derived
+ *	from the seed, which keeps the stratification of the sequence while decorrelating runs with different seeds.
+ */
+template<size_t N> class SobolSequence
+{
+public:
+	static_assert(N > 0 && N <= SOBOL_MAX_DIMENSIONS, "Unsupported number of dimensions!");
+
+	SobolSequence(unsigned long long nSeed = 0, bool bScramble = true)
+	{
+		// direction numbers
+		for (size_t d = 0; d < N; d++)
+		{
+			auto& v = this->m_directions[d];
+
+			if (d == 0)
+			{
+				for (unsigned int k = 0; k < SOBOL_BITS; k++)
+					v[k] = 1u << (SOBOL_BITS - 1 - k);
+
+				continue;
+			}
+
+			unsigned int s = sobol_degree[d];
+			unsigned int a = sobol_coeffs[d];
+
+			for (unsigned int k = 0; k < s; k++)
+				v[k] = sobol_init[d][k] << (SOBOL_BITS - 1 - k);
+
+			for (unsigned int k = s; k < SOBOL_BITS; k++)
+			{
+				unsigned int x = v[k - s] ^ (v[k - s] >> s);
+
+				for (unsigned int i = 1; i < s; i++)
+					if ((a >> (s - 1 - i)) & 1)
+						x ^= v[k - i];
+
+				v[k] = x;
+			}
+		}
+
+		// digital shift
+		std::mt19937_64 generator(nSeed);
+
+		for (size_t d = 0; d < N; d++)
+			this->m_shift[d] = bScramble ? (unsigned int)(generator() >> 32) : 0;
+	}
+
+	// return point of given index, the first 2^m points of a scrambled sequence cover each slice of width 2^-m once
+	std::array<double, N> point(unsigned long long nIndex) const
+	{
+		unsigned int gray = (unsigned int)(nIndex ^ (nIndex >> 1));
+
+		std::array<double, N> ret;
+
+		for (size_t d = 0; d < N; d++)
+		{
+			unsigned int x = this->m_shift[d];
+
+			for (unsigned int k = 0; k < SOBOL_BITS && (gray >> k) != 0; k++)
+				if ((gray >> k) & 1)
+					x ^= this->m_directions[d][k];
+
+			ret[d] = (double)x / 4294967296.0;
+		}
+
+		return ret;
+	}
+
+	// return point of given index mapped into bounds
+	std::array<double, N> sample(unsigned long long nIndex, const std::array<double, N>& vec_min, const std::array<double, N>& vec_max) const
+	{
+		auto ret = point(nIndex);
+
+		for (size_t d = 0; d < N; d++)
+			ret[d] = vec_min[d] + ret[d] * (vec_max[d] - vec_min[d]);
+
+		return ret;
+	}
+
+private:
+	unsigned int m_directions[N][SOBOL_BITS];
+	unsigned int m_shift[N];
+};
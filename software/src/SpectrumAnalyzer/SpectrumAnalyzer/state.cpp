@@ -25,7 +25,7 @@ bool SpectrumAnalyzerChild::hasBlank(void) const
     return this->m_pApp->hasBlank();
 }
 
-vector_t SpectrumAnalyzerChild::getBlank(void) const
+const vector_t& SpectrumAnalyzerChild::getBlank(void) const
 {
     if (this->m_pApp == nullptr)
         throwException(InvalidFunctionException);
@@ -177,6 +177,14 @@ bool SpectrumAnalyzerChild::isBaselineRemovalEnabled(void) const
     return this->m_pApp->isBaselineRemovalEnabled();
 }
 
+BaselineRemovalAlgorithm SpectrumAnalyzerChild::getBaselineAlgorithm(void) const
+{
+    if (this->m_pApp == nullptr)
+        throwException(InvalidFunctionException);
+
+    return this->m_pApp->getBaselineAlgorithm();
+}
+
 bool SpectrumAnalyzerChild::isBlankRemovalEnabled(void) const
 {
     if (this->m_pApp == nullptr)
@@ -289,6 +297,14 @@ void SpectrumAnalyzerChild::setCamera(const std::string& camera)
     this->m_pApp->setCamera(camera);
 }
 
+std::string SpectrumAnalyzerChild::getCameraUID(void) const
+{
+    if (this->m_pApp == nullptr)
+        throwException(InvalidFunctionException);
+
+    return this->m_pApp->getCameraUID();
+}
+
 void SpectrumAnalyzerChild::onConfirmImageSave(const std::string& rTitle)
 {
     if (this->m_pApp == nullptr)
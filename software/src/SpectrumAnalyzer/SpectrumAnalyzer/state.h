@@ -21,6 +21,7 @@
 #include "shared/storage/stdext.h"
 
 #include "shared/math/vector.h"
+#include "shared/math/baseline.h"
 
 #include "shared/gui/signal.h"
 #include "shared/gui/axis.h"
@@ -50,7 +51,7 @@ class ISpectrumAnalyzerGlobals
 {
 protected:
     virtual bool hasBlank(void) const = 0;
-    virtual vector_t getBlank(void) const = 0;
+    virtual const vector_t& getBlank(void) const = 0;
     virtual bool hasBlankOpt(void) const = 0;
 
     virtual bool isParamDialogOpened(void) const = 0;
@@ -74,6 +75,7 @@ protected:
     virtual int getSmoothing(void) const = 0;
     virtual bool isMedFiltEnabled(void) const = 0;
     virtual bool isBaselineRemovalEnabled(void) const = 0;
+    virtual BaselineRemovalAlgorithm getBaselineAlgorithm(void) const = 0;
     virtual bool isBlankRemovalEnabled(void) const = 0;
     virtual double getExposure(void) const = 0;
     virtual double getGain(void) const = 0;
@@ -90,6 +92,7 @@ protected:
     virtual bool hasCamera(void) const = 0;
     virtual void disconnectCamera(void) = 0;
     virtual void setCamera(const std::string& camera) = 0;
+    virtual std::string getCameraUID(void) const = 0;
 
     virtual void onConfirmImageSave(const std::string& rTitle) = 0;
 
@@ -113,7 +116,7 @@ public:
 
 protected:
     virtual bool hasBlank(void) const override;
-    virtual vector_t getBlank(void) const override;
+    virtual const vector_t& getBlank(void) const override;
     virtual bool hasBlankOpt(void) const override;
 
     virtual bool isParamDialogOpened(void) const override;
@@ -137,6 +140,7 @@ protected:
     virtual int getSmoothing(void) const override;
     virtual bool isMedFiltEnabled(void) const override;
     virtual bool isBaselineRemovalEnabled(void) const override;
+    virtual BaselineRemovalAlgorithm getBaselineAlgorithm(void) const override;
     virtual bool isBlankRemovalEnabled(void) const override;
     virtual double getExposure(void) const override;
     virtual double getGain(void) const override;
@@ -152,6 +156,7 @@ protected:
     virtual bool hasCamera(void) const override;
     virtual void disconnectCamera(void) override;
     virtual void setCamera(const std::string& camera) override;
+    virtual std::string getCameraUID(void) const override;
 
     virtual void onConfirmImageSave(const std::string& rTitle) override;
 
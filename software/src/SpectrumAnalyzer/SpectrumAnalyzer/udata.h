@@ -131,7 +131,7 @@ public:
     }
 
     // build plot
-    virtual void buildPlot(std::shared_ptr<guiPlot> pPlot) const override
+    virtual void buildPlot(std::shared_ptr<guiPlot> pPlot, const ProcessingParameters& rParams) const override
     {
         // skip if no plot
         if (pPlot == nullptr)
@@ -149,7 +149,7 @@ public:
 
             // set data
             pPlot->series[0].x = this->m_x.data;
-            pPlot->series[0].y = format(this->m_y.data);
+            format_into(pPlot->series[0].y, this->m_y.data, rParams);
 
             // set axis title
             pPlot->haxis1.title.text = this->m_x.header;
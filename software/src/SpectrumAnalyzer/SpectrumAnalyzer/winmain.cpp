@@ -18,6 +18,8 @@
 #include "shared/utils/exception.h"
 #include "shared/utils/evemon.h"
 
+#include "shared/math/benchmark.h"
+
 #include "app.h"
 
 #pragma comment(linker,"\"/manifestdependency:type='win32' name='Microsoft.Windows.Common-Controls' version='6.0.0.0' processorArchitecture='*' publicKeyToken='6595b64144ccf1df' language='*'\"")
@@ -90,6 +92,12 @@ BOOL WINAPI WinMain(HINSTANCE hInstance, HINSTANCE HprevInstance, LPSTR lpCmdLin
 {
 	_debug("Starting SpectrumAnalyzer");
 
+#ifdef __BENCHMARK__
+	// send math kernels timings to event monitor
+	for (auto& v : benchmark_all())
+		_debug("%s", toString(v).c_str());
+#endif
+
 	// check if program is already opened
 	HWND hPrevWnd = FindWindow(CLASS_NAME, NULL);
 
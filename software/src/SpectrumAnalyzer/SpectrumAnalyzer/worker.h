@@ -0,0 +1,232 @@
+/*
+ *	2020 (C) The Pulsar Engineering
+ *	http://www.thepulsar.be
+ *
+ *	This document is licensed under the CERN OHL-W v2 (http://ohwr.org/cernohl).
+ *
+ *	You may redistribute and modify this document under the terms of the
+ *	CERN OHL-W v2 only. This document is distributed WITHOUT ANY EXPRESS OR
+ *	IMPLIED WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY AND
+ *	FITNESS FOR APARTICULAR PURPOSE. Please refer to the CERN OHL-W v2 for
+ *	applicable conditions.
+ */
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <Windows.h>
+
+#include "shared/utils/evemon.h"
+#include "shared/utils/thread.h"
+#include "shared/utils/utils.h"
+#include "shared/gui/plot.h"
+
+#include "data.h"
+
+// message posted to the main window when a new snapshot is available
+#define WM_PLOT_SNAPSHOT			(WM_APP + 1)
+
+// maximum time the worker sleeps before checking for termination
+#define PLOT_WORKER_IDLE_DELAY		0.1
+
+// finished build, never modified once published
+struct PlotSnapshot
+{
+	unsigned long long version;
+
+	std::shared_ptr<const guiPlot> pPlot;
+};
+
+// copy plot and redirect series bound to the axes of the source to the axes of the destination
+static void assign_plot(guiPlot& rDst, const guiPlot& rSrc)
+{
+	rDst = rSrc;
+
+	auto rebase = [&](guiAxis*& pAxis)
+	{
+		if (pAxis == &rSrc.haxis1)
+			pAxis = &rDst.haxis1;
+		else if (pAxis == &rSrc.haxis2)
+			pAxis = &rDst.haxis2;
+		else if (pAxis == &rSrc.vaxis1)
+			pAxis = &rDst.vaxis1;
+		else if (pAxis == &rSrc.vaxis2)
+			pAxis = &rDst.vaxis2;
+		else
+		{
+			for (size_t i = 0; i < rSrc.axis_ex.size(); i++)
+				if (pAxis == &rSrc.axis_ex[i])
+					pAxis = &rDst.axis_ex[i];
+		}
+	};
+
+	for (auto& v : rDst.series)
+	{
+		rebase(v.pHorizontalAxis);
+		rebase(v.pVerticalAxis);
+	}
+}
+
+/*
+ *	background plot builder
+ *
+ *	Requests carry their own plot, a copy of the annotations and the processing parameters so that the worker
+ *	never touches objects owned by the UI thread. Only the latest pending request is kept: a request arriving while another one
+ *	is waiting replaces it, so a burst of parameter changes costs a single build. Each finished build is
+ *	published as an immutable snapshot tagged with the version of its request, and the owner window is
+ *	told through WM_PLOT_SNAPSHOT to swap it in.
+ */
+class PlotWorker : public IThread
+{
+public:
+	PlotWorker(void)
+	{
+		this->m_hWnd = NULL;
+		this->m_hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+		this->m_nVersion = 0;
+		this->m_bPending = false;
+
+		this->m_latest.version = 0;
+	}
+
+	virtual ~PlotWorker(void)
+	{
+		// thread must be gone before the event
+		try
+		{
+			if (isRunning())
+				stop();
+		}
+		catch (...) {}
+
+		if (this->m_hEvent != NULL)
+			CloseHandle(this->m_hEvent);
+	}
+
+	// set window receiving the snapshot notifications
+	void setWindow(HWND hWnd)
+	{
+		this->m_hWnd = hWnd;
+	}
+
+	// queue a build, replacing any request not yet started, and return its version
+	unsigned long long request(std::shared_ptr<IPlotBuilder> pBuilder, std::shared_ptr<guiPlot> pPlot, std::vector<guiSignal> annotations, std::shared_ptr<const ProcessingParameters> pParameters)
+	{
+		AUTOLOCK(this->m_mutex);
+
+		this->m_request.version = ++this->m_nVersion;
+		this->m_request.pBuilder = pBuilder;
+		this->m_request.pPlot = pPlot;
+		this->m_request.annotations = std::move(annotations);
+		this->m_request.pParameters = pParameters;
+
+		this->m_bPending = true;
+
+		SetEvent(this->m_hEvent);
+
+		return this->m_request.version;
+	}
+
+	// return version of the last request
+	unsigned long long getRequestedVersion(void) const
+	{
+		AUTOLOCK(this->m_mutex);
+
+		return this->m_nVersion;
+	}
+
+	// return newest finished snapshot
+	PlotSnapshot getSnapshot(void) const
+	{
+		AUTOLOCK(this->m_mutex);
+
+		return this->m_latest;
+	}
+
+protected:
+	virtual void run(void) override
+	{
+		// wait for a request, with timeout to honor termination
+		WaitForSingleObject(this->m_hEvent, (DWORD)(PLOT_WORKER_IDLE_DELAY * 1000.0));
+
+		// take latest request
+		Request request;
+
+		{
+			AUTOLOCK(this->m_mutex);
+
+			if (!this->m_bPending)
+				return;
+
+			request = std::move(this->m_request);
+
+			this->m_request = Request();
+			this->m_bPending = false;
+		}
+
+		if (request.pBuilder == nullptr || request.pPlot == nullptr || request.pParameters == nullptr)
+			return;
+
+		// build outside of the lock so that newer requests can be queued meanwhile
+		try
+		{
+			request.pBuilder->build(request.pPlot, request.annotations, *request.pParameters);
+		}
+		catch (IException& rException)
+		{
+			_error("%s", rException.toString().c_str());
+
+			return;
+		}
+		catch (...)
+		{
+			_error("Unknown error while building plot!");
+
+			return;
+		}
+
+		// publish
+		{
+			AUTOLOCK(this->m_mutex);
+
+			if (request.version > this->m_latest.version)
+			{
+				this->m_latest.version = request.version;
+				this->m_latest.pPlot = request.pPlot;
+			}
+		}
+
+		if (this->m_hWnd != NULL)
+			PostMessage(this->m_hWnd, WM_PLOT_SNAPSHOT, (WPARAM)0, (LPARAM)0);
+	}
+
+private:
+	struct Request
+	{
+		Request(void)
+		{
+			this->version = 0;
+		}
+
+		unsigned long long version;
+
+		std::shared_ptr<IPlotBuilder> pBuilder;
+		std::shared_ptr<guiPlot> pPlot;
+		std::vector<guiSignal> annotations;
+		std::shared_ptr<const ProcessingParameters> pParameters;
+	};
+
+	HWND m_hWnd;
+	HANDLE m_hEvent;
+
+	unsigned long long m_nVersion;
+	bool m_bPending;
+
+	Request m_request;
+	PlotSnapshot m_latest;
+
+	mutable std::mutex m_mutex;
+};
@@ -14,14 +14,26 @@
 
 #include "../utils/exception.h"
 
+#include "banded.h"
 #include "vector.h"
 
 // types of baseline removal algorithm
 enum class BaselineRemovalAlgorithm
 {
 	Schulze,
+	AsLS,
+	arPLS,
+	airPLS,
 };
 
+// default parameters of the penalized least-squares baselines
+#define PLS_BASELINE_LAMBDA				1e5
+#define PLS_BASELINE_ORDER				2
+#define PLS_BASELINE_ASYMMETRY			1e-3
+#define PLS_BASELINE_TOLERANCE			1e-3
+#define PLS_BASELINE_MAX_ITERATIONS		50
+#define AIRPLS_BASELINE_MAX_ITERATIONS	15
+
 // NoBaselineFoundException class
 class NoBaselineFoundException : public IException
 {
@@ -32,69 +44,387 @@ public:
 	}
 };
 
-// baseline correction based on Schulze, H. Georg, et al. "A small-window moving average-based fully automated baseline estimation method for Raman spectra." Applied spectroscopy 66.7 (2012): 757-764.
-static vector_t baseline_schulze(const vector_t& vec)
+/*
+ *	state carried from one frame to the next
+ *
+ *	Keeps the penalty matrix and factorization buffers of the penalized least-squares baselines, and the
+ *	weights they converged to. Live spectra barely change between frames so starting from the previous
+ *	weights usually converges in one or two iterations instead of ten or more.
+ */
+class BaselineState
 {
-	// trapezoidal integration
-	auto trapz = [](const vector_t& vec)
+public:
+	BaselineState(void)
+	{
+		this->m_eAlgorithm = BaselineRemovalAlgorithm::Schulze;
+		this->m_fLambda = 0;
+		this->m_nOrder = 0;
+		this->m_nIterations = 0;
+	}
+
+	// forget previous frame
+	void reset(void)
+	{
+		this->weights.clear();
+	}
+
+	// return number of iterations of the last run
+	size_t getIterations(void) const
 	{
-		double fIntegral = 0;
+		return this->m_nIterations;
+	}
+
+	// prepare for a new frame, returns true if previous weights can be reused
+	bool prepare(size_t nSize, BaselineRemovalAlgorithm eAlgorithm, double fLambda, size_t nOrder)
+	{
+		// rebuild penalty if problem changed
+		if (this->penalty.size() != nSize || this->m_fLambda != fLambda || this->m_nOrder != nOrder)
+		{
+			this->penalty = difference_penalty(nSize, nOrder, fLambda);
 
-		if (vec.size() == 0)
-			return (double)0;
+			this->m_fLambda = fLambda;
+			this->m_nOrder = nOrder;
+		}
 
-		for (size_t i = 0; i < vec.size()-1; i++)
-			fIntegral += 0.5 * (vec[i] + vec[i + 1]);
+		bool bWarm = (this->weights.size() == nSize && this->m_eAlgorithm == eAlgorithm);
 
-		return fIntegral;
-	};
+		if (!bWarm)
+			this->weights.assign(nSize, 1.0);
 
-	// initialize filtered spectrum to input vector
-	auto S = vec;
+		this->m_eAlgorithm = eAlgorithm;
 
-	// keep last 3 results into circular buffer
-	struct
+		return bWarm;
+	}
+
+	// solve (W + lambda D^T D) z = W y into z
+	void solve(vector_t& z, const vector_t& y)
 	{
-		vector_t baseline;
-		double cost;
-	} data[3];
+		size_t n = y.size();
+
+		this->system = this->penalty;
+		this->system.addDiagonal(this->weights);
+
+		this->cholesky.factor(this->system);
+
+		for (size_t i = 0; i < n; i++)
+			z[i] = this->weights[i] * y[i];
 
-	// loop until solution has been found
-	size_t i = 0;
+		this->cholesky.solve_inplace(z);
+	}
 
-	while ((i + 1) * 2 < vec.size())
+	// set number of iterations of the last run
+	void setIterations(size_t nIterations)
 	{
-		auto& curr = data[i % 3];
+		this->m_nIterations = nIterations;
+	}
 
-		// remove peaks
-		curr.baseline = minvec(S, boxcar(S, (i + 1) * 2));
+	vector_t weights;
 
-		// compute cost and add to list
-		curr.cost = trapz(S - curr.baseline);
+	BandedMatrix penalty, system;
+	BandedCholesky cholesky;
 
-		// set new filtered spectrum
-		S = curr.baseline;
+private:
+	BaselineRemovalAlgorithm m_eAlgorithm;
+
+	double m_fLambda;
+	size_t m_nOrder;
+	size_t m_nIterations;
+};
+
+// one Schulze iteration, dst = min(src, boxcar(src, k)) in a single pass, returns the trapezoidal area of src - dst
+template<typename Type> static double schulze_step(Type* pDst, const Type* pSrc, size_t n, size_t nKernelSize)
+{
+	double fWeight = 1.0 / (double)nKernelSize;
+
+	// window of element i covers [i - k/2, i - k/2 + k - 1], indices are clamped like boxcar()
+	int nLast = (int)n - 1;
+	int nHalf = (int)(nKernelSize >> 1);
+	int nKernel = (int)nKernelSize;
+
+	double fSum = 0;
+	double fArea = 0;
+
+	for (int j = 0; j < nKernel; j++)
+		fSum += (double)pSrc[bound(j - nHalf, 0, nLast)];
+
+	for (int i = 0; i <= nLast; i++)
+	{
+		Type lowpass = (Type)(fWeight * fSum);
 
-		// end condition is middlepoint having the lowest cost
-		if (i >= 3 && data[(i - 1) % 3].cost < data[(i - 2) % 3].cost && data[(i - 1) % 3].cost < curr.cost)
-			return data[(i - 1) % 3].baseline;
+		pDst[i] = min(pSrc[i], lowpass);
 
-		// increment iteration
-		i++;
+		fArea += (double)(pSrc[i] - pDst[i]);
+
+		// slide window, clamping is only needed close to the edges
+		if (i >= nHalf && i - nHalf + nKernel <= nLast)
+			fSum += (double)pSrc[i - nHalf + nKernel] - (double)pSrc[i - nHalf];
+		else
+			fSum += (double)pSrc[bound(i - nHalf + nKernel, 0, nLast)] - (double)pSrc[bound(i - nHalf, 0, nLast)];
 	}
 
-	throwException(NoBaselineFoundException);
+	// trapezoidal rule counts both ends with half weight
+	return fArea - 0.5 * ((double)(pSrc[0] - pDst[0]) + (double)(pSrc[nLast] - pDst[nLast]));
 }
 
-// generic baseline removal dispatch
-static vector_t baseline(const vector_t& vec, BaselineRemovalAlgorithm eAlgorithm)
+// run Schulze iterations until the removed area is minimum, returns that iteration or zero
+template<typename Type> static size_t schulze_search(std::vector<Type>& rOutput, const std::vector<Type>& vec)
+{
+	size_t n = vec.size();
+
+	// the iteration only needs the previous baseline and the one being computed
+	auto buf0 = scratch<Type>(n);
+	auto buf1 = scratch<Type>(n);
+
+	std::vector<Type>* buffers[2] = { &*buf0, &*buf1 };
+
+	// removed area of the last three iterations
+	double costs[3] = { 0, 0, 0 };
+
+	// filtered spectrum is the input vector, then the previous baseline
+	const std::vector<Type>* pS = &vec;
+
+	for (size_t i = 0; (i + 1) * 2 < n; i++)
+	{
+		auto pCurr = buffers[i % 2];
+
+		costs[i % 3] = schulze_step(pCurr->data(), pS->data(), n, (i + 1) * 2);
+
+		// end condition is middlepoint having the lowest cost, its baseline is still held by pS
+		if (i >= 3 && costs[(i - 1) % 3] < costs[(i - 2) % 3] && costs[(i - 1) % 3] < costs[i % 3])
+		{
+			rOutput.assign(pS->begin(), pS->end());
+
+			return i;
+		}
+
+		pS = pCurr;
+	}
+
+	return 0;
+}
+
+// baseline correction based on Schulze, H. Georg, et al. "A small-window moving average-based fully automated baseline estimation method for Raman spectra." Applied spectroscopy 66.7 (2012): 757-764.
+template<typename Type> static void baseline_schulze_into(std::vector<Type>& rOutput, const std::vector<Type>& vec)
+{
+	if (schulze_search(rOutput, vec) == 0)
+		throwException(NoBaselineFoundException);
+}
+
+// baseline correction based on Schulze
+template<typename Type> static std::vector<Type> baseline_schulze(const std::vector<Type>& vec)
+{
+	std::vector<Type> ret;
+
+	baseline_schulze_into(ret, vec);
+
+	return ret;
+}
+
+/*
+ *	iteratively reweighted penalized least-squares baselines, solving (W + lambda D^T D) z = W y
+ *
+ *	AsLS: Eilers, P. H. C., and Boelens, H. F. M. "Baseline correction with asymmetric least squares smoothing." (2005).
+ *	arPLS: Baek, S.-J., et al. "Baseline correction using asymmetrically reweighted penalized least squares smoothing." Analyst 140.1 (2015): 250-257.
+ *	airPLS: Zhang, Z.-M., et al. "Baseline correction using adaptive iteratively reweighted penalized least squares." Analyst 135.5 (2010): 1138-1146.
+ *
+ *	The system is banded so each iteration is O(n). Pass a state to warm-start from the previous frame.
+ */
+template<typename Type> static void baseline_pls_into(std::vector<Type>& rOutput, const std::vector<Type>& vec, BaselineRemovalAlgorithm eAlgorithm, BaselineState* pState = nullptr, double fLambda = PLS_BASELINE_LAMBDA)
+{
+	size_t n = vec.size();
+
+	if (n <= PLS_BASELINE_ORDER + 1)
+		throwException(NoBaselineFoundException);
+
+	// use a cold state if none is given
+	BaselineState local;
+
+	auto& state = (pState != nullptr) ? *pState : local;
+
+	state.prepare(n, eAlgorithm, fLambda, PLS_BASELINE_ORDER);
+
+	auto& w = state.weights;
+
+	// work in double precision
+	auto y = scratch<double>(n);
+	auto z = scratch<double>(n);
+
+	convert_into(*y, vec);
+
+	double fNorm = 0;
+
+	for (size_t i = 0; i < n; i++)
+		fNorm += fabs((*y)[i]);
+
+	size_t nMaxIterations = (eAlgorithm == BaselineRemovalAlgorithm::airPLS) ? AIRPLS_BASELINE_MAX_ITERATIONS : PLS_BASELINE_MAX_ITERATIONS;
+
+	size_t nIteration = 0;
+
+	while (nIteration < nMaxIterations)
+	{
+		nIteration++;
+
+		state.solve(*z, *y);
+
+		bool bConverged = false;
+
+		switch (eAlgorithm)
+		{
+		// fixed asymmetric weights, converged once no weight flips
+		case BaselineRemovalAlgorithm::AsLS:
+			{
+				size_t nChanges = 0;
+
+				for (size_t i = 0; i < n; i++)
+				{
+					double fWeight = ((*y)[i] > (*z)[i]) ? PLS_BASELINE_ASYMMETRY : 1.0 - PLS_BASELINE_ASYMMETRY;
+
+					if (fWeight != w[i])
+						nChanges++;
+
+					w[i] = fWeight;
+				}
+
+				bConverged = (nChanges == 0);
+			}
+			break;
+
+		// logistic weights from the statistics of the negative residuals
+		case BaselineRemovalAlgorithm::arPLS:
+			{
+				double fSum = 0, fSum2 = 0;
+				size_t nNeg = 0;
+
+				for (size_t i = 0; i < n; i++)
+				{
+					double d = (*y)[i] - (*z)[i];
+
+					if (d < 0)
+					{
+						fSum += d;
+						fSum2 += d * d;
+						nNeg++;
+					}
+				}
+
+				if (nNeg < 2)
+				{
+					bConverged = true;
+					break;
+				}
+
+				double fMean = fSum / (double)nNeg;
+				double fStd = sqrt(max(0.0, fSum2 / (double)nNeg - fMean * fMean));
+
+				if (fStd <= 0)
+				{
+					bConverged = true;
+					break;
+				}
+
+				double fDelta = 0, fNormWeights = 0;
+
+				for (size_t i = 0; i < n; i++)
+				{
+					double d = (*y)[i] - (*z)[i];
+
+					double fWeight = 1.0 / (1.0 + exp(min(700.0, 2.0 * (d - (2.0 * fStd - fMean)) / fStd)));
+
+					fDelta += (fWeight - w[i]) * (fWeight - w[i]);
+					fNormWeights += w[i] * w[i];
+
+					w[i] = fWeight;
+				}
+
+				bConverged = (sqrt(fDelta) < PLS_BASELINE_TOLERANCE * sqrt(fNormWeights));
+			}
+			break;
+
+		// exponential weights on negative residuals, growing with iterations
+		case BaselineRemovalAlgorithm::airPLS:
+			{
+				double fNegSum = 0, fNegMax = 0;
+
+				for (size_t i = 0; i < n; i++)
+				{
+					double d = (*y)[i] - (*z)[i];
+
+					if (d < 0)
+					{
+						fNegSum -= d;
+						fNegMax = max(fNegMax, -d);
+					}
+				}
+
+				if (fNegSum < PLS_BASELINE_TOLERANCE * fNorm)
+				{
+					bConverged = true;
+					break;
+				}
+
+				for (size_t i = 0; i < n; i++)
+				{
+					double d = (*y)[i] - (*z)[i];
+
+					w[i] = (d >= 0) ? 0 : exp(min(700.0, (double)nIteration * (-d) / fNegSum));
+				}
+
+				// keep both ends anchored with the weight of the largest negative residual, max(-d) over d < 0. The
+				// reference code takes the signed max(d) over d < 0, which is the smallest negative residual and
+				// leaves the ends weaker than any point below the baseline
+				w[0] = w[n - 1] = exp(min(700.0, (double)nIteration * fNegMax / fNegSum));
+			}
+			break;
+
+		default:
+			throwException(NoBaselineFoundException);
+		}
+
+		if (bConverged)
+			break;
+	}
+
+	state.setIterations(nIteration);
+
+	convert_into(rOutput, *z);
+}
+
+// generic baseline removal dispatch into output vector, the state is optional and only used by algorithms that support warm start
+template<typename Type> static void baseline_into(std::vector<Type>& rOutput, const std::vector<Type>& vec, BaselineRemovalAlgorithm eAlgorithm, BaselineState* pState = nullptr)
 {
 	switch (eAlgorithm)
 	{
 	case BaselineRemovalAlgorithm::Schulze:
-		return baseline_schulze(vec);
+		baseline_schulze_into(rOutput, vec);
+		break;
+
+	case BaselineRemovalAlgorithm::AsLS:
+	case BaselineRemovalAlgorithm::arPLS:
+	case BaselineRemovalAlgorithm::airPLS:
+		baseline_pls_into(rOutput, vec, eAlgorithm, pState);
+		break;
 
 	default:
 		throwException(NoBaselineFoundException);
 	}
 }
+
+// generic baseline removal dispatch
+template<typename Type> static std::vector<Type> baseline(const std::vector<Type>& vec, BaselineRemovalAlgorithm eAlgorithm)
+{
+	std::vector<Type> ret;
+
+	baseline_into(ret, vec, eAlgorithm);
+
+	return ret;
+}
+
+// subtract baseline from vector in place
+template<typename Type> static void remove_baseline_inplace(std::vector<Type>& vec, BaselineRemovalAlgorithm eAlgorithm, BaselineState* pState = nullptr)
+{
+	auto base = scratch<Type>(vec.size());
+
+	baseline_into(*base, vec, eAlgorithm, pState);
+
+	vec -= *base;
+}
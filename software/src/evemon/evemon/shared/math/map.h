@@ -94,7 +94,7 @@ public:
 
 		// copy data
 		for (size_t n = 0; n < nNumElements; n++)
-			this->m_pData[n] = (double)rMap.m_pData[n];
+			this->m_pData[n] = rMap.m_pData[n];
 
 		return *this;
 	}
@@ -172,7 +172,7 @@ public:
 	}
 
 	// get pixel (non-const version)
-	double& operator()(size_t x, size_t y)
+	Type& operator()(size_t x, size_t y)
 	{
 		// throw error if beyond dimensions
 		if (x >= this->m_nWidth || y >= this->m_nHeight)
@@ -183,7 +183,7 @@ public:
 	}
 
 	// get pixel (const version)
-	const double operator()(size_t x, size_t y) const
+	const Type operator()(size_t x, size_t y) const
 	{
 		// throw error if beyond dimensions
 		if (x >= this->m_nWidth || y >= this->m_nHeight)
@@ -193,20 +193,42 @@ public:
 		return this->m_pData[__ADD(x, __MULT(y, this->m_nWidth))];
 	}
 
+	// unchecked access to a row, for inner loops that already validated dimensions
+	Type* row(size_t y)
+	{
+		return this->m_pData + y * this->m_nWidth;
+	}
+
+	const Type* row(size_t y) const
+	{
+		return this->m_pData + y * this->m_nWidth;
+	}
+
+	// unchecked access to contiguous data, rows are stored one after another
+	Type* data(void)
+	{
+		return this->m_pData;
+	}
+
+	const Type* data(void) const
+	{
+		return this->m_pData;
+	}
+
 private:
 	size_t m_nWidth, m_nHeight;
 
 	Type* m_pData;
 };
 
-// image_t type is a Map2D<double> type
-using image_t = Map2D<double>;
+// image_t type is a Map2D<float> type, single precision is enough for 16-bit sensors
+using image_t = Map2D<float>;
 
 // maximum size for the median filtering kernel
 #define MAX_MEDFILT2_KERNEL_SIZE		10
 
 // median filtering, brute force algorithm
-static image_t medfilt2(const image_t& rInput, size_t nKernelSize=3)
+template<typename Type> static Map2D<Type> medfilt2(const Map2D<Type>& rInput, size_t nKernelSize=3)
 {
 	// skip if kernel is below or equal to 1 (1=no effect, 0=undefined)
 	if (nKernelSize <= 1)
@@ -216,7 +238,7 @@ static image_t medfilt2(const image_t& rInput, size_t nKernelSize=3)
 	nKernelSize = min(nKernelSize, MAX_MEDFILT2_KERNEL_SIZE);
 
 	// allocate size
-	image_t ret(rInput.getWidth(), rInput.getHeight());
+	Map2D<Type> ret(rInput.getWidth(), rInput.getHeight());
 
 	// fill with zeros
 	ret = 0;
@@ -228,7 +250,7 @@ static image_t medfilt2(const image_t& rInput, size_t nKernelSize=3)
 	ret.perpixel([&](size_t x, size_t y)
 		{
 			// get data around the pixel
-			double temp[MAX_MEDFILT2_KERNEL_SIZE * MAX_MEDFILT2_KERNEL_SIZE];
+			Type temp[MAX_MEDFILT2_KERNEL_SIZE * MAX_MEDFILT2_KERNEL_SIZE];
 			size_t n = 0;
 
 			for (int yy = ((int)y + lo); yy <= ((int)y + hi); yy++)
@@ -243,8 +265,8 @@ static image_t medfilt2(const image_t& rInput, size_t nKernelSize=3)
 	return ret;
 }
 
-// create a vector by summing columns of the image
-static auto sum_cols(const image_t& rImage)
+// create a vector by summing columns of the image, sum is done in double precision
+template<typename Type> static auto sum_cols(const Map2D<Type>& rImage)
 {
 	vector_t vec(rImage.getWidth());
 
@@ -259,8 +281,8 @@ static auto sum_cols(const image_t& rImage)
 	return vec;
 }
 
-// create a vector by summing rows of the image
-static auto sum_rows(const image_t& rImage)
+// create a vector by summing rows of the image, sum is done in double precision
+template<typename Type> static auto sum_rows(const Map2D<Type>& rImage)
 {
 	vector_t vec(rImage.getHeight());
 
@@ -276,7 +298,7 @@ static auto sum_rows(const image_t& rImage)
 }
 
 // create a vector by getting the maximum value in each column on the image
-static auto max_cols(const image_t& rImage)
+template<typename Type> static auto max_cols(const Map2D<Type>& rImage)
 {
 	vector_t vec(rImage.getWidth());
 
@@ -285,14 +307,14 @@ static auto max_cols(const image_t& rImage)
 		vec[x] = rImage(x, 0);
 
 		for (size_t y = 1; y < rImage.getHeight(); y++)
-			vec[x] = max(vec[x], rImage(x, y));
+			vec[x] = max(vec[x], (double)rImage(x, y));
 	}
 
 	return vec;
 }
 
 // create a vector by getting the maximum value in each row on the image
-static auto max_rows(const image_t& rImage)
+template<typename Type> static auto max_rows(const Map2D<Type>& rImage)
 {
 	vector_t vec(rImage.getHeight());
 
@@ -301,14 +323,14 @@ static auto max_rows(const image_t& rImage)
 		vec[y] = rImage(0, y);
 
 		for (size_t x = 1; x < rImage.getWidth(); x++)
-			vec[y] = max(vec[y], rImage(x, y));
+			vec[y] = max(vec[y], (double)rImage(x, y));
 	}
 
 	return vec;
 }
 
 // save image to bitmap
-static void imsave(const image_t& rMap, const std::string& rFilename)
+template<typename Type> static void imsave(const Map2D<Type>& rMap, const std::string& rFilename)
 {
 	BITMAPFILEHEADER bmp_header;
 	BITMAPINFOHEADER bmp_info;
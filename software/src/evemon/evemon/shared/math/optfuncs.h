@@ -17,6 +17,13 @@
 
 #include "../utils/exception.h"
 
+#include "sampling.h"
+
+// early exit of multi-start searches, stop once the best cost has not improved for a fraction of the starts
+#define GLOBALSEARCH_PATIENCE_FRACTION		0.25
+#define GLOBALSEARCH_MIN_PATIENCE			32
+#define GLOBALSEARCH_MIN_IMPROVEMENT		1e-6
+
 template<size_t N> auto operator+(const std::array<double, N>& vec1, const std::array<double, N>& vec2)
 {
 	std::array<double, N> ret;
@@ -368,18 +375,268 @@ template<size_t N> std::array<double, N> fminsearch(std::function< double(const
 	return curr_simplex[0].x;
 }
 
-// global search method using randomly sampled points and local search method
-template<size_t N> std::array<double, N> globalsearch(std::function< std::array<double, N>(std::function< double(const std::array<double, N>&)>, const std::array<double, N>&)> pLocalSearchFunction, std::function< double(const std::array<double, N>&)> pCostFunction, std::function< bool(const std::array<double, N>&)> pConstraintsFunction, const std::array<double, N>& rMinBounds, const std::array<double, N>& rMaxBounds, size_t nNumSamples)
+/*
+ *	same simplex method with the cost function as a template parameter
+ *
+ *	The cost is inlined instead of called through std::function and the simplex lives on the stack. Vertices stay sorted:
+ *	a replaced worst vertex is moved to its rank by an insertion step, and only a shrink, which moves every vertex but the
+ *	best, sorts again. The centroid comes from a running sum of the vertices updated in O(N) per replacement.
+ *	Iterates and stopping conditions follow fminsearch.
+ */
+template<size_t N, typename CostFunction> std::array<double, N> fminsearch_fast(CostFunction&& rCostFunction, const std::array<double, N>& rInitialVector, size_t nMaxIterations = 0, double fTolX = 1.0e-4, double fTolFun = 1.0e-4)
 {
+	static_assert(N > 0, "Invalid initial vector!");
+
+	const double fReflectionCoeff = 1;
+	const double fExpansionCoeff = 2;
+	const double fContractionCoeff = 0.5;
+	const double fShrinkageCoeff = 0.5;
+
+	struct simplex_s
+	{
+		std::array<double, N> x;
+		double cost;
+	};
+
+	// follow Matlab conventions
+	if (nMaxIterations == 0)
+		nMaxIterations = __MULT(N, (size_t)200);
+
+	// exit condition following matlab convention
+	auto matlab_compare = [=](const simplex_s& curr, const simplex_s& prev)
+	{
+		double fDist = 0, fLength = 0;
+
+		for (size_t i = 0; i < N; i++)
+		{
+			fDist += (curr.x[i] - prev.x[i]) * (curr.x[i] - prev.x[i]);
+			fLength += prev.x[i] * prev.x[i];
+		}
+
+		bool condition1 = sqrt(fDist) < fTolX * (1.0 + sqrt(fLength));
+		bool condition2 = fabs(curr.cost - prev.cost) < fTolFun * (1.0 + fabs(prev.cost));
+
+		return condition1 & condition2;
+	};
+
+	// point on the line from the centroid through p, xm + t * (p - xm)
+	auto along = [](const std::array<double, N>& xm, const std::array<double, N>& p, double t)
+	{
+		std::array<double, N> ret;
+
+		for (size_t i = 0; i < N; i++)
+			ret[i] = xm[i] + t * (p[i] - xm[i]);
+
+		return ret;
+	};
+
+	// build initial simplex
+	simplex_s simplex[N + 1];
+
+	simplex[N].x = rInitialVector;
+
+	for (size_t i = 0; i < N; i++)
+	{
+		// copy initial vector to current simplex
+		simplex[i].x = rInitialVector;
+
+		// set coordinate #i to 0.00025 if null or increase by 5%
+		simplex[i].x[i] = (simplex[i].x[i] == 0) ? 0.00025 : rInitialVector[i] * 1.05;
+	}
+
+	// evaluate simplex
+	for (auto& v : simplex)
+		v.cost = rCostFunction(v.x);
+
+	// sort all vertices by ascending cost and compute their sum
+	std::array<double, N> xsum;
+
+	auto sort_all = [&](void)
+	{
+		for (size_t i = 1; i <= N; i++)
+		{
+			simplex_s v = simplex[i];
+
+			size_t j = i;
+
+			for (; j > 0 && v.cost < simplex[j - 1].cost; j--)
+				simplex[j] = simplex[j - 1];
+
+			simplex[j] = v;
+		}
+
+		xsum.fill(0);
+
+		for (auto& v : simplex)
+			for (size_t i = 0; i < N; i++)
+				xsum[i] += v.x[i];
+	};
+
+	// replace worst vertex and move it to its rank
+	auto replace_worst = [&](const simplex_s& v)
+	{
+		for (size_t i = 0; i < N; i++)
+			xsum[i] += v.x[i] - simplex[N].x[i];
+
+		size_t j = N;
+
+		for (; j > 0 && v.cost < simplex[j - 1].cost; j--)
+			simplex[j] = simplex[j - 1];
+
+		simplex[j] = v;
+	};
+
+	sort_all();
+
+	// loop
+	for (size_t nIter = 0; nIter < nMaxIterations; nIter++)
+	{
+		// mean pos on 'n' best points
+		std::array<double, N> xm;
+
+		for (size_t i = 0; i < N; i++)
+			xm[i] = (xsum[i] - simplex[N].x[i]) / (double)N;
+
+		// reflect
+		simplex_s reflect;
+
+		reflect.x = along(xm, simplex[N].x, -fReflectionCoeff);
+		reflect.cost = rCostFunction(reflect.x);
+
+		// accept reflection
+		if (reflect.cost >= simplex[0].cost && reflect.cost < simplex[N - 1].cost)
+		{
+			// check for convergence
+			if (matlab_compare(reflect, simplex[N]))
+				return simplex[0].x;
+
+			// otherelse replace last point
+			replace_worst(reflect);
+
+			continue;
+		}
+
+		// expand
+		if (reflect.cost < simplex[0].cost)
+		{
+			simplex_s expand;
+
+			expand.x = along(xm, reflect.x, fExpansionCoeff);
+			expand.cost = rCostFunction(expand.x);
+
+			// accept expansion
+			if (expand.cost < reflect.cost)
+			{
+				// check for convergence
+				if (matlab_compare(simplex[N], expand))
+					return expand.x;
+
+				replace_worst(expand);
+			}
+			// accept reflection
+			else
+			{
+				// check for convergence
+				if (matlab_compare(simplex[N], reflect))
+					return reflect.x;
+
+				replace_worst(reflect);
+			}
+
+			continue;
+		}
+
+		// contract
+		simplex_s contract;
+
+		// inside contraction
+		if (reflect.cost >= simplex[N].cost)
+		{
+			contract.x = along(xm, simplex[N].x, fContractionCoeff);
+			contract.cost = rCostFunction(contract.x);
+
+			// accept contraction
+			if (contract.cost < simplex[N].cost)
+			{
+				// check for convergence
+				if (matlab_compare(simplex[N], contract))
+					return simplex[0].x;
+
+				// otherelse replace last point
+				replace_worst(contract);
+
+				continue;
+			}
+		}
+		// outside contraction
+		else
+		{
+			contract.x = along(xm, reflect.x, fContractionCoeff);
+			contract.cost = rCostFunction(contract.x);
+
+			// accept contraction
+			if (contract.cost <= reflect.cost)
+			{
+				// check for convergence
+				if (matlab_compare(simplex[N], contract))
+					return simplex[0].x;
+
+				// otherelse replace last point
+				replace_worst(contract);
+
+				continue;
+			}
+		}
+
+		// shrink
+		for (size_t i = 1; i <= N; i++)
+		{
+			simplex[i].x = along(simplex[0].x, simplex[i].x, fShrinkageCoeff);
+			simplex[i].cost = rCostFunction(simplex[i].x);
+		}
+
+		sort_all();
+	}
+
+	// return best vector
+	return simplex[0].x;
+}
+
+// return number of starts without improvement after which a search of nNumSamples starts gives up
+static size_t globalsearch_patience(size_t nNumSamples)
+{
+	return max((size_t)GLOBALSEARCH_MIN_PATIENCE, (size_t)(GLOBALSEARCH_PATIENCE_FRACTION * (double)nNumSamples));
+}
+
+// return true if new cost is a significant improvement over the best one
+static bool globalsearch_improved(double fNewCost, double fBestCost)
+{
+	return fNewCost < fBestCost - GLOBALSEARCH_MIN_IMPROVEMENT * fabs(fBestCost);
+}
+
+// global search method using quasi-random starting points and local search method, same seed gives same result
+template<size_t N> std::array<double, N> globalsearch(std::function< std::array<double, N>(std::function< double(const std::array<double, N>&)>, const std::array<double, N>&)> pLocalSearchFunction, std::function< double(const std::array<double, N>&)> pCostFunction, std::function< bool(const std::array<double, N>&)> pConstraintsFunction, const std::array<double, N>& rMinBounds, const std::array<double, N>& rMaxBounds, size_t nNumSamples, unsigned long long nSeed = 0, bool bEarlyExit = true)
+{
+	SobolSequence<N> sequence(nSeed);
+
 	// hold best result
 	std::array<double, N> bestCoefficients;
 	double fBestCost = 0;
 
+	bool bFound = false;
+
+	size_t nLastImprovement = 0;
+	size_t nPatience = globalsearch_patience(nNumSamples);
+
 	// generate solutions
 	for (size_t i = 0; i < nNumSamples; i++)
 	{
-		// randomize starting position
-		auto start_coeffs = randomize(rMinBounds, rMaxBounds);
+		// stop if best cost did not improve for a while
+		if (bEarlyExit && bFound && i - nLastImprovement > nPatience)
+			break;
+
+		// starting position
+		auto start_coeffs = sequence.sample(i, rMinBounds, rMaxBounds);
 
 		// use local search method
 		auto fit_coeffs = pLocalSearchFunction(pCostFunction, start_coeffs);
@@ -392,13 +649,18 @@ template<size_t N> std::array<double, N> globalsearch(std::function< std::array<
 		auto fCost = pCostFunction(fit_coeffs);
 
 		// save best
-		if (i == 0 || fCost < fBestCost)
+		if (!bFound || fCost < fBestCost)
 		{
+			if (!bFound || globalsearch_improved(fCost, fBestCost))
+				nLastImprovement = i;
+
 			bestCoefficients = fit_coeffs;
 			fBestCost = fCost;
+
+			bFound = true;
 		}
 	}
 
 	// return best coefficients
 	return bestCoefficients;
-}
\ No newline at end of file
+}
@@ -0,0 +1,587 @@
+/*
+ *	2020 (C) The Pulsar Engineering
+ *	http://www.thepulsar.be
+ *
+ *	This document is licensed under the CERN OHL-W v2 (http://ohwr.org/cernohl).
+ *
+ *	You may redistribute and modify this document under the terms of the
+ *	CERN OHL-W v2 only. This document is distributed WITHOUT ANY EXPRESS OR
+ *	IMPLIED WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY AND
+ *	FITNESS FOR APARTICULAR PURPOSE. Please refer to the CERN OHL-W v2 for
+ *	applicable conditions.
+ */
+#pragma once
+
+#include <intrin.h>
+#include <immintrin.h>
+
+// instruction sets supported by the kernels, from slowest to fastest
+enum class SimdLevel
+{
+	Scalar,
+	SSE2,
+	AVX2,
+	AVX512,
+};
+
+// table of element-wise kernels for a given instruction set and scalar type
+template<typename Type> struct SimdKernels
+{
+	SimdLevel level;
+	const char* name;
+
+	// dst = a + b, dst = a - b, dst = a * b
+	void (*add)(Type* pDst, const Type* pA, const Type* pB, size_t n);
+	void (*sub)(Type* pDst, const Type* pA, const Type* pB, size_t n);
+	void (*mul)(Type* pDst, const Type* pA, const Type* pB, size_t n);
+
+	// dst = a * s, dst = a / s, dst = a + s
+	void (*scale)(Type* pDst, const Type* pA, Type s, size_t n);
+	void (*div)(Type* pDst, const Type* pA, Type s, size_t n);
+	void (*offset)(Type* pDst, const Type* pA, Type s, size_t n);
+
+	// dst = a * s + b
+	void (*fma)(Type* pDst, const Type* pA, Type s, const Type* pB, size_t n);
+
+	// dst = min(a, b), dst = max(a, b), dst = min(max(a, lo), hi)
+	void (*vmin)(Type* pDst, const Type* pA, const Type* pB, size_t n);
+	void (*vmax)(Type* pDst, const Type* pA, const Type* pB, size_t n);
+	void (*clamp)(Type* pDst, const Type* pA, Type lo, Type hi, size_t n);
+
+	// reductions, n must be at least 1 for minval/maxval
+	Type (*sum)(const Type* pA, size_t n);
+	Type (*dot)(const Type* pA, const Type* pB, size_t n);
+	Type (*minval)(const Type* pA, size_t n);
+	Type (*maxval)(const Type* pA, size_t n);
+};
+
+// scalar instruction set
+template<typename Type> struct SimdScalarISA
+{
+	using scalar_t = Type;
+	using reg_t = Type;
+
+	static const size_t width = 1;
+
+	static reg_t load(const Type* p) { return *p; }
+	static void store(Type* p, reg_t v) { *p = v; }
+	static reg_t set1(Type v) { return v; }
+
+	static reg_t add(reg_t a, reg_t b) { return a + b; }
+	static reg_t sub(reg_t a, reg_t b) { return a - b; }
+	static reg_t mul(reg_t a, reg_t b) { return a * b; }
+	static reg_t div(reg_t a, reg_t b) { return a / b; }
+	static reg_t fmadd(reg_t a, reg_t b, reg_t c) { return a * b + c; }
+	static reg_t vmin(reg_t a, reg_t b) { return (a < b) ? a : b; }
+	static reg_t vmax(reg_t a, reg_t b) { return (a > b) ? a : b; }
+
+	static Type hsum(reg_t v) { return v; }
+	static Type hmin(reg_t v) { return v; }
+	static Type hmax(reg_t v) { return v; }
+};
+
+// SSE2 instruction set
+template<typename Type> struct SimdSSE2ISA;
+
+// SSE2 instruction set, double precision (2 lanes)
+template<> struct SimdSSE2ISA<double>
+{
+	using scalar_t = double;
+	using reg_t = __m128d;
+
+	static const size_t width = 2;
+
+	static reg_t load(const double* p) { return _mm_loadu_pd(p); }
+	static void store(double* p, reg_t v) { _mm_storeu_pd(p, v); }
+	static reg_t set1(double v) { return _mm_set1_pd(v); }
+
+	static reg_t add(reg_t a, reg_t b) { return _mm_add_pd(a, b); }
+	static reg_t sub(reg_t a, reg_t b) { return _mm_sub_pd(a, b); }
+	static reg_t mul(reg_t a, reg_t b) { return _mm_mul_pd(a, b); }
+	static reg_t div(reg_t a, reg_t b) { return _mm_div_pd(a, b); }
+	static reg_t fmadd(reg_t a, reg_t b, reg_t c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+	static reg_t vmin(reg_t a, reg_t b) { return _mm_min_pd(a, b); }
+	static reg_t vmax(reg_t a, reg_t b) { return _mm_max_pd(a, b); }
+
+	static double hsum(reg_t v) { return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v))); }
+	static double hmin(reg_t v) { return _mm_cvtsd_f64(_mm_min_sd(v, _mm_unpackhi_pd(v, v))); }
+	static double hmax(reg_t v) { return _mm_cvtsd_f64(_mm_max_sd(v, _mm_unpackhi_pd(v, v))); }
+};
+
+// SSE2 instruction set, single precision (4 lanes)
+template<> struct SimdSSE2ISA<float>
+{
+	using scalar_t = float;
+	using reg_t = __m128;
+
+	static const size_t width = 4;
+
+	static reg_t load(const float* p) { return _mm_loadu_ps(p); }
+	static void store(float* p, reg_t v) { _mm_storeu_ps(p, v); }
+	static reg_t set1(float v) { return _mm_set1_ps(v); }
+
+	static reg_t add(reg_t a, reg_t b) { return _mm_add_ps(a, b); }
+	static reg_t sub(reg_t a, reg_t b) { return _mm_sub_ps(a, b); }
+	static reg_t mul(reg_t a, reg_t b) { return _mm_mul_ps(a, b); }
+	static reg_t div(reg_t a, reg_t b) { return _mm_div_ps(a, b); }
+	static reg_t fmadd(reg_t a, reg_t b, reg_t c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	static reg_t vmin(reg_t a, reg_t b) { return _mm_min_ps(a, b); }
+	static reg_t vmax(reg_t a, reg_t b) { return _mm_max_ps(a, b); }
+
+	static float hsum(reg_t v) { v = _mm_add_ps(v, _mm_movehl_ps(v, v)); return _mm_cvtss_f32(_mm_add_ss(v, _mm_shuffle_ps(v, v, 1))); }
+	static float hmin(reg_t v) { v = _mm_min_ps(v, _mm_movehl_ps(v, v)); return _mm_cvtss_f32(_mm_min_ss(v, _mm_shuffle_ps(v, v, 1))); }
+	static float hmax(reg_t v) { v = _mm_max_ps(v, _mm_movehl_ps(v, v)); return _mm_cvtss_f32(_mm_max_ss(v, _mm_shuffle_ps(v, v, 1))); }
+};
+
+// AVX2 + FMA3 instruction set
+template<typename Type> struct SimdAVX2ISA;
+
+// AVX2 + FMA3 instruction set, double precision (4 lanes)
+template<> struct SimdAVX2ISA<double>
+{
+	using scalar_t = double;
+	using reg_t = __m256d;
+
+	static const size_t width = 4;
+
+	static reg_t load(const double* p) { return _mm256_loadu_pd(p); }
+	static void store(double* p, reg_t v) { _mm256_storeu_pd(p, v); }
+	static reg_t set1(double v) { return _mm256_set1_pd(v); }
+
+	static reg_t add(reg_t a, reg_t b) { return _mm256_add_pd(a, b); }
+	static reg_t sub(reg_t a, reg_t b) { return _mm256_sub_pd(a, b); }
+	static reg_t mul(reg_t a, reg_t b) { return _mm256_mul_pd(a, b); }
+	static reg_t div(reg_t a, reg_t b) { return _mm256_div_pd(a, b); }
+	static reg_t fmadd(reg_t a, reg_t b, reg_t c) { return _mm256_fmadd_pd(a, b, c); }
+	static reg_t vmin(reg_t a, reg_t b) { return _mm256_min_pd(a, b); }
+	static reg_t vmax(reg_t a, reg_t b) { return _mm256_max_pd(a, b); }
+
+	static double hsum(reg_t v) { return SimdSSE2ISA<double>::hsum(_mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1))); }
+	static double hmin(reg_t v) { return SimdSSE2ISA<double>::hmin(_mm_min_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1))); }
+	static double hmax(reg_t v) { return SimdSSE2ISA<double>::hmax(_mm_max_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1))); }
+};
+
+// AVX2 + FMA3 instruction set, single precision (8 lanes)
+template<> struct SimdAVX2ISA<float>
+{
+	using scalar_t = float;
+	using reg_t = __m256;
+
+	static const size_t width = 8;
+
+	static reg_t load(const float* p) { return _mm256_loadu_ps(p); }
+	static void store(float* p, reg_t v) { _mm256_storeu_ps(p, v); }
+	static reg_t set1(float v) { return _mm256_set1_ps(v); }
+
+	static reg_t add(reg_t a, reg_t b) { return _mm256_add_ps(a, b); }
+	static reg_t sub(reg_t a, reg_t b) { return _mm256_sub_ps(a, b); }
+	static reg_t mul(reg_t a, reg_t b) { return _mm256_mul_ps(a, b); }
+	static reg_t div(reg_t a, reg_t b) { return _mm256_div_ps(a, b); }
+	static reg_t fmadd(reg_t a, reg_t b, reg_t c) { return _mm256_fmadd_ps(a, b, c); }
+	static reg_t vmin(reg_t a, reg_t b) { return _mm256_min_ps(a, b); }
+	static reg_t vmax(reg_t a, reg_t b) { return _mm256_max_ps(a, b); }
+
+	static float hsum(reg_t v) { return SimdSSE2ISA<float>::hsum(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1))); }
+	static float hmin(reg_t v) { return SimdSSE2ISA<float>::hmin(_mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1))); }
+	static float hmax(reg_t v) { return SimdSSE2ISA<float>::hmax(_mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1))); }
+};
+
+// AVX-512F instruction set
+template<typename Type> struct SimdAVX512ISA;
+
+// AVX-512F instruction set, double precision (8 lanes)
+template<> struct SimdAVX512ISA<double>
+{
+	using scalar_t = double;
+	using reg_t = __m512d;
+
+	static const size_t width = 8;
+
+	static reg_t load(const double* p) { return _mm512_loadu_pd(p); }
+	static void store(double* p, reg_t v) { _mm512_storeu_pd(p, v); }
+	static reg_t set1(double v) { return _mm512_set1_pd(v); }
+
+	static reg_t add(reg_t a, reg_t b) { return _mm512_add_pd(a, b); }
+	static reg_t sub(reg_t a, reg_t b) { return _mm512_sub_pd(a, b); }
+	static reg_t mul(reg_t a, reg_t b) { return _mm512_mul_pd(a, b); }
+	static reg_t div(reg_t a, reg_t b) { return _mm512_div_pd(a, b); }
+	static reg_t fmadd(reg_t a, reg_t b, reg_t c) { return _mm512_fmadd_pd(a, b, c); }
+	static reg_t vmin(reg_t a, reg_t b) { return _mm512_min_pd(a, b); }
+	static reg_t vmax(reg_t a, reg_t b) { return _mm512_max_pd(a, b); }
+
+	static double hsum(reg_t v) { return SimdAVX2ISA<double>::hsum(_mm256_add_pd(_mm512_castpd512_pd256(v), _mm512_extractf64x4_pd(v, 1))); }
+	static double hmin(reg_t v) { return SimdAVX2ISA<double>::hmin(_mm256_min_pd(_mm512_castpd512_pd256(v), _mm512_extractf64x4_pd(v, 1))); }
+	static double hmax(reg_t v) { return SimdAVX2ISA<double>::hmax(_mm256_max_pd(_mm512_castpd512_pd256(v), _mm512_extractf64x4_pd(v, 1))); }
+};
+
+// AVX-512F instruction set, single precision (16 lanes)
+template<> struct SimdAVX512ISA<float>
+{
+	using scalar_t = float;
+	using reg_t = __m512;
+
+	static const size_t width = 16;
+
+	static reg_t load(const float* p) { return _mm512_loadu_ps(p); }
+	static void store(float* p, reg_t v) { _mm512_storeu_ps(p, v); }
+	static reg_t set1(float v) { return _mm512_set1_ps(v); }
+
+	static reg_t add(reg_t a, reg_t b) { return _mm512_add_ps(a, b); }
+	static reg_t sub(reg_t a, reg_t b) { return _mm512_sub_ps(a, b); }
+	static reg_t mul(reg_t a, reg_t b) { return _mm512_mul_ps(a, b); }
+	static reg_t div(reg_t a, reg_t b) { return _mm512_div_ps(a, b); }
+	static reg_t fmadd(reg_t a, reg_t b, reg_t c) { return _mm512_fmadd_ps(a, b, c); }
+	static reg_t vmin(reg_t a, reg_t b) { return _mm512_min_ps(a, b); }
+	static reg_t vmax(reg_t a, reg_t b) { return _mm512_max_ps(a, b); }
+
+	// upper half is extracted as doubles since _mm512_extractf32x8_ps requires AVX-512DQ
+	static __m256 hi(reg_t v) { return _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1)); }
+
+	static float hsum(reg_t v) { return SimdAVX2ISA<float>::hsum(_mm256_add_ps(_mm512_castps512_ps256(v), hi(v))); }
+	static float hmin(reg_t v) { return SimdAVX2ISA<float>::hmin(_mm256_min_ps(_mm512_castps512_ps256(v), hi(v))); }
+	static float hmax(reg_t v) { return SimdAVX2ISA<float>::hmax(_mm256_max_ps(_mm512_castps512_ps256(v), hi(v))); }
+};
+
+// dst = a + b
+template<class ISA, typename Type = typename ISA::scalar_t> void simd_add(Type* pDst, const Type* pA, const Type* pB, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + ISA::width <= n; i += ISA::width)
+		ISA::store(pDst + i, ISA::add(ISA::load(pA + i), ISA::load(pB + i)));
+
+	for (; i < n; i++)
+		pDst[i] = pA[i] + pB[i];
+}
+
+// dst = a - b
+template<class ISA, typename Type = typename ISA::scalar_t> void simd_sub(Type* pDst, const Type* pA, const Type* pB, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + ISA::width <= n; i += ISA::width)
+		ISA::store(pDst + i, ISA::sub(ISA::load(pA + i), ISA::load(pB + i)));
+
+	for (; i < n; i++)
+		pDst[i] = pA[i] - pB[i];
+}
+
+// dst = a * b
+template<class ISA, typename Type = typename ISA::scalar_t> void simd_mul(Type* pDst, const Type* pA, const Type* pB, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + ISA::width <= n; i += ISA::width)
+		ISA::store(pDst + i, ISA::mul(ISA::load(pA + i), ISA::load(pB + i)));
+
+	for (; i < n; i++)
+		pDst[i] = pA[i] * pB[i];
+}
+
+// dst = a * s
+template<class ISA, typename Type = typename ISA::scalar_t> void simd_scale(Type* pDst, const Type* pA, Type s, size_t n)
+{
+	auto vs = ISA::set1(s);
+	size_t i = 0;
+
+	for (; i + ISA::width <= n; i += ISA::width)
+		ISA::store(pDst + i, ISA::mul(ISA::load(pA + i), vs));
+
+	for (; i < n; i++)
+		pDst[i] = pA[i] * s;
+}
+
+// dst = a / s
+template<class ISA, typename Type = typename ISA::scalar_t> void simd_div(Type* pDst, const Type* pA, Type s, size_t n)
+{
+	auto vs = ISA::set1(s);
+	size_t i = 0;
+
+	for (; i + ISA::width <= n; i += ISA::width)
+		ISA::store(pDst + i, ISA::div(ISA::load(pA + i), vs));
+
+	for (; i < n; i++)
+		pDst[i] = pA[i] / s;
+}
+
+// dst = a + s
+template<class ISA, typename Type = typename ISA::scalar_t> void simd_offset(Type* pDst, const Type* pA, Type s, size_t n)
+{
+	auto vs = ISA::set1(s);
+	size_t i = 0;
+
+	for (; i + ISA::width <= n; i += ISA::width)
+		ISA::store(pDst + i, ISA::add(ISA::load(pA + i), vs));
+
+	for (; i < n; i++)
+		pDst[i] = pA[i] + s;
+}
+
+// dst = a * s + b
+template<class ISA, typename Type = typename ISA::scalar_t> void simd_fma(Type* pDst, const Type* pA, Type s, const Type* pB, size_t n)
+{
+	auto vs = ISA::set1(s);
+	size_t i = 0;
+
+	for (; i + ISA::width <= n; i += ISA::width)
+		ISA::store(pDst + i, ISA::fmadd(ISA::load(pA + i), vs, ISA::load(pB + i)));
+
+	for (; i < n; i++)
+		pDst[i] = pA[i] * s + pB[i];
+}
+
+// dst = min(a, b)
+template<class ISA, typename Type = typename ISA::scalar_t> void simd_vmin(Type* pDst, const Type* pA, const Type* pB, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + ISA::width <= n; i += ISA::width)
+		ISA::store(pDst + i, ISA::vmin(ISA::load(pA + i), ISA::load(pB + i)));
+
+	for (; i < n; i++)
+		pDst[i] = (pA[i] < pB[i]) ? pA[i] : pB[i];
+}
+
+// dst = max(a, b)
+template<class ISA, typename Type = typename ISA::scalar_t> void simd_vmax(Type* pDst, const Type* pA, const Type* pB, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + ISA::width <= n; i += ISA::width)
+		ISA::store(pDst + i, ISA::vmax(ISA::load(pA + i), ISA::load(pB + i)));
+
+	for (; i < n; i++)
+		pDst[i] = (pA[i] > pB[i]) ? pA[i] : pB[i];
+}
+
+// dst = min(max(a, lo), hi)
+template<class ISA, typename Type = typename ISA::scalar_t> void simd_clamp(Type* pDst, const Type* pA, Type lo, Type hi, size_t n)
+{
+	auto vlo = ISA::set1(lo);
+	auto vhi = ISA::set1(hi);
+	size_t i = 0;
+
+	for (; i + ISA::width <= n; i += ISA::width)
+		ISA::store(pDst + i, ISA::vmin(ISA::vmax(ISA::load(pA + i), vlo), vhi));
+
+	for (; i < n; i++)
+	{
+		Type v = (pA[i] > lo) ? pA[i] : lo;
+
+		pDst[i] = (v < hi) ? v : hi;
+	}
+}
+
+// sum of elements, uses two accumulators to hide add latency
+template<class ISA, typename Type = typename ISA::scalar_t> Type simd_sum(const Type* pA, size_t n)
+{
+	auto acc0 = ISA::set1(0);
+	auto acc1 = ISA::set1(0);
+	size_t i = 0;
+
+	for (; i + 2 * ISA::width <= n; i += 2 * ISA::width)
+	{
+		acc0 = ISA::add(acc0, ISA::load(pA + i));
+		acc1 = ISA::add(acc1, ISA::load(pA + i + ISA::width));
+	}
+
+	for (; i + ISA::width <= n; i += ISA::width)
+		acc0 = ISA::add(acc0, ISA::load(pA + i));
+
+	Type fSum = ISA::hsum(ISA::add(acc0, acc1));
+
+	for (; i < n; i++)
+		fSum += pA[i];
+
+	return fSum;
+}
+
+// dot product, uses two accumulators to hide fma latency
+template<class ISA, typename Type = typename ISA::scalar_t> Type simd_dot(const Type* pA, const Type* pB, size_t n)
+{
+	auto acc0 = ISA::set1(0);
+	auto acc1 = ISA::set1(0);
+	size_t i = 0;
+
+	for (; i + 2 * ISA::width <= n; i += 2 * ISA::width)
+	{
+		acc0 = ISA::fmadd(ISA::load(pA + i), ISA::load(pB + i), acc0);
+		acc1 = ISA::fmadd(ISA::load(pA + i + ISA::width), ISA::load(pB + i + ISA::width), acc1);
+	}
+
+	for (; i + ISA::width <= n; i += ISA::width)
+		acc0 = ISA::fmadd(ISA::load(pA + i), ISA::load(pB + i), acc0);
+
+	Type fSum = ISA::hsum(ISA::add(acc0, acc1));
+
+	for (; i < n; i++)
+		fSum += pA[i] * pB[i];
+
+	return fSum;
+}
+
+// minimum of elements
+template<class ISA, typename Type = typename ISA::scalar_t> Type simd_minval(const Type* pA, size_t n)
+{
+	Type fRet = pA[0];
+	size_t i = 0;
+
+	if (n >= ISA::width)
+	{
+		auto acc = ISA::load(pA);
+
+		for (i = ISA::width; i + ISA::width <= n; i += ISA::width)
+			acc = ISA::vmin(acc, ISA::load(pA + i));
+
+		fRet = ISA::hmin(acc);
+	}
+
+	for (; i < n; i++)
+		fRet = (pA[i] < fRet) ? pA[i] : fRet;
+
+	return fRet;
+}
+
+// maximum of elements
+template<class ISA, typename Type = typename ISA::scalar_t> Type simd_maxval(const Type* pA, size_t n)
+{
+	Type fRet = pA[0];
+	size_t i = 0;
+
+	if (n >= ISA::width)
+	{
+		auto acc = ISA::load(pA);
+
+		for (i = ISA::width; i + ISA::width <= n; i += ISA::width)
+			acc = ISA::vmax(acc, ISA::load(pA + i));
+
+		fRet = ISA::hmax(acc);
+	}
+
+	for (; i < n; i++)
+		fRet = (pA[i] > fRet) ? pA[i] : fRet;
+
+	return fRet;
+}
+
+// build kernel table for an instruction set
+template<class ISA> SimdKernels<typename ISA::scalar_t> simd_make_kernels(SimdLevel eLevel, const char* pszName)
+{
+	SimdKernels<typename ISA::scalar_t> ret;
+
+	ret.level = eLevel;
+	ret.name = pszName;
+
+	ret.add = &simd_add<ISA>;
+	ret.sub = &simd_sub<ISA>;
+	ret.mul = &simd_mul<ISA>;
+	ret.scale = &simd_scale<ISA>;
+	ret.div = &simd_div<ISA>;
+	ret.offset = &simd_offset<ISA>;
+	ret.fma = &simd_fma<ISA>;
+	ret.vmin = &simd_vmin<ISA>;
+	ret.vmax = &simd_vmax<ISA>;
+	ret.clamp = &simd_clamp<ISA>;
+	ret.sum = &simd_sum<ISA>;
+	ret.dot = &simd_dot<ISA>;
+	ret.minval = &simd_minval<ISA>;
+	ret.maxval = &simd_maxval<ISA>;
+
+	return ret;
+}
+
+// return true if the processor and the OS support an instruction set
+static bool simd_supported(SimdLevel eLevel)
+{
+	int info[4];
+
+	// get highest function
+	__cpuid(info, 0);
+
+	int nMaxFunction = info[0];
+
+	if (nMaxFunction < 1)
+		return eLevel == SimdLevel::Scalar;
+
+	__cpuid(info, 1);
+
+	bool bSSE2 = (info[3] & (1 << 26)) != 0;
+	bool bFMA = (info[2] & (1 << 12)) != 0;
+	bool bOSXSAVE = (info[2] & (1 << 27)) != 0;
+	bool bAVX = (info[2] & (1 << 28)) != 0;
+
+	bool bAVX2 = false;
+	bool bAVX512F = false;
+
+	if (nMaxFunction >= 7)
+	{
+		__cpuidex(info, 7, 0);
+
+		bAVX2 = (info[1] & (1 << 5)) != 0;
+		bAVX512F = (info[1] & (1 << 16)) != 0;
+	}
+
+	// check the OS saves YMM/ZMM registers on context switch
+	unsigned long long xcr0 = bOSXSAVE ? _xgetbv(0) : 0;
+
+	bool bYMM = (xcr0 & 0x06) == 0x06;
+	bool bZMM = (xcr0 & 0xe6) == 0xe6;
+
+	switch (eLevel)
+	{
+	case SimdLevel::Scalar:
+		return true;
+
+	case SimdLevel::SSE2:
+		return bSSE2;
+
+	case SimdLevel::AVX2:
+		return bAVX && bAVX2 && bFMA && bYMM;
+
+	case SimdLevel::AVX512:
+		return bAVX512F && bYMM && bZMM;
+
+	default:
+		return false;
+	}
+}
+
+// return kernels for a specific instruction set (falls back to scalar if not supported)
+template<typename Type = double> static SimdKernels<Type> simd_kernels(SimdLevel eLevel)
+{
+	if (!simd_supported(eLevel))
+		eLevel = SimdLevel::Scalar;
+
+	switch (eLevel)
+	{
+	case SimdLevel::AVX512:
+		return simd_make_kernels<SimdAVX512ISA<Type>>(SimdLevel::AVX512, "AVX-512");
+
+	case SimdLevel::AVX2:
+		return simd_make_kernels<SimdAVX2ISA<Type>>(SimdLevel::AVX2, "AVX2");
+
+	case SimdLevel::SSE2:
+		return simd_make_kernels<SimdSSE2ISA<Type>>(SimdLevel::SSE2, "SSE2");
+
+	default:
+	case SimdLevel::Scalar:
+		return simd_make_kernels<SimdScalarISA<Type>>(SimdLevel::Scalar, "Scalar");
+	}
+}
+
+// return best kernels for this processor and scalar type, detection is done once
+template<typename Type = double> static const SimdKernels<Type>& simd(void)
+{
+	static const SimdKernels<Type> kernels = []()
+	{
+		const SimdLevel levels[] = { SimdLevel::AVX512, SimdLevel::AVX2, SimdLevel::SSE2 };
+
+		for (auto eLevel : levels)
+			if (simd_supported(eLevel))
+				return simd_kernels<Type>(eLevel);
+
+		return simd_kernels<Type>(SimdLevel::Scalar);
+	}();
+
+	return kernels;
+}
@@ -505,7 +505,7 @@ public:
 
 		for (size_t y = 0; y < nHeight; y++)
 			for (size_t x = 0; x < nWidth; x++)
-				img(x, y) = (double)myhtons(pPointer[x + y * nStride]) / 65535.0;
+				img(x, y) = (float)((double)myhtons(pPointer[x + y * nStride]) / 65535.0);
 
 		// release image
 		pImage->Release();
@@ -12,17 +12,67 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
 #include <functional>
+#include <random>
+#include <vector>
 
 #include "../utils/exception.h"
+#include "../utils/parallel.h"
 #include "../utils/thread.h"
 #include "../utils/safe.h"
 
 #include "vector.h"
+#include "matrix.h"
 #include "optfuncs.h"
 #include "legendre.h"
 #include "peaks.h"
 
+// number of following peaks, and reference lines, paired with each peak to form triplets when matching lines
+#define RANSAC_PEAK_WINDOW			3
+#define RANSAC_LINE_WINDOW			6
+
+// maximum difference between the spacing ratios of a peak triplet and a line triplet
+#define RANSAC_RATIO_TOLERANCE		0.03
+
+// distance, in nm, below which a peak is attributed to a line
+#define RANSAC_INLIER_THRESHOLD		1.0
+
+// number of hypotheses refined, and maximum number of refinement iterations
+#define RANSAC_REFINE_CANDIDATES	32
+#define RANSAC_REFINE_ITERATIONS	20
+
+// number of assigned peaks per model coefficient while growing an hypothesis
+#define RANSAC_PEAKS_PER_TERM		2
+
+// largest number of coefficients of the polynomial models
+#define CALIBRATION_MAX_COEFFS				8
+
+// distance, in nm, above which a peak is left out of the refinement
+#define CALIBRATION_REFINE_THRESHOLD		1.0
+
+// iteration limit and relative decrease of the cost below which the refinement has converged
+#define CALIBRATION_REFINE_MAX_ITERATIONS	20
+#define CALIBRATION_REFINE_TOLERANCE		1e-12
+
+// damping limits
+#define CALIBRATION_REFINE_MIN_LAMBDA		1e-12
+#define CALIBRATION_REFINE_MAX_LAMBDA		1e12
+
+// RMS error, in nm, above which a warm start is rejected and the global search is run
+#define CALIBRATION_WARMSTART_MAX_RMS		0.15
+
+// fraction of the peaks that must be attributed to a line for a warm start to be accepted
+#define CALIBRATION_WARMSTART_MIN_PEAKS		0.9
+
+// largest drift, in normalized indices, between the peaks of a previous calibration and the current ones
+#define CALIBRATION_WARMSTART_MAX_SHIFT		0.05
+
+// distance, in normalized indices, below which a peak is paired with a previous one once the drift is removed
+#define CALIBRATION_WARMSTART_TOLERANCE		0.005
+
 // type of reference peaks
 enum class CalibrationData
 {
@@ -59,17 +109,22 @@ static vector_t getCalibrationData(CalibrationData eCalibrationData)
 // project indices into wavelengths according to polynomial a[0] + a[1] * x + a[2] * x + ...
 template<size_t N> double index2wavelength(const std::array<double, N>& rModelCoeffs, double fIndex)
 {
-    double fProj = 0;
+    return legendre_series(rModelCoeffs, fIndex);
+}
+
+// project all pixels of a sensor of size n, mapped to [-1, 1], into wavelengths
+template<size_t N> void index2wavelength_into(vector_t& rOutput, const std::array<double, N>& rModelCoeffs, size_t n)
+{
+    vector_t x(n);
 
-    for (size_t i = 0; i < N; i++)
-        fProj += rModelCoeffs[i] * legendre((unsigned int)i, fIndex);
-        // fProj += rModelCoeffs[i] * quickpow(fIndex, (unsigned int)i);
+    for (size_t i = 0; i < n; i++)
+        x[i] = 2 * (double)i / (double)(n - 1) - 1;
 
-    return fProj;
+    legendre_series_into(rOutput, rModelCoeffs, x);
 }
 
 // return model coefficient of determination
-template<size_t N> double getCalibrationModelR2(const std::array<double, N>& rModelCoeffs, const vector_t& rPeakIndices, const vector_t& rPeakWavelengths)
+template<size_t N> double getCalibrationModelR2(const std::array<double, N>& rModelCoeffs, const vector_t& rPeakIndices, const PeakIndex& rPeakWavelengths)
 {
     // skip if no coefficients
     if (rPeakIndices.size() == 0 || rPeakWavelengths.size() == 0)
@@ -96,7 +151,7 @@ template<size_t N> double getCalibrationModelR2(const std::array<double, N>& rMo
 }
 
 // return RMS error
-template<size_t N> double getCalibrationModelRMS(const std::array<double, N>& rModelCoeffs, const vector_t& rPeakIndices, const vector_t& rPeakWavelengths)
+template<size_t N> double getCalibrationModelRMS(const std::array<double, N>& rModelCoeffs, const vector_t& rPeakIndices, const PeakIndex& rPeakWavelengths)
 {
     // skip if no coefficients
     if (rPeakIndices.size() == 0 || rPeakWavelengths.size() == 0)
@@ -121,6 +176,9 @@ template<size_t N> double getCalibrationModelRMS(const std::array<double, N>& rM
 // calibrate peaks based on a 'N' degree polynomial
 template<size_t N> std::array<double, N> calibratePeaks(const vector_t& rPeakIndices, const vector_t& rPeakWavelengths, const std::array<double, N>& rMinVector, const std::array<double, N>& rMaxVector, size_t nNumSamples, std::function< bool(const std::array<double, N>&)> pConstraintsFunction)
 {
+    // sorted reference lines
+    PeakIndex reference(rPeakWavelengths);
+
     // cost function
     auto cost = [&](const std::array<double, N>& coeffs)
     {
@@ -130,17 +188,334 @@ template<size_t N> std::array<double, N> calibratePeaks(const vector_t& rPeakInd
 
         // compute distance of all peaks
         for (auto& v : rPeakIndices)
-            fCost += distPeaks(rPeakWavelengths, index2wavelength(coeffs, v));
+            fCost += distPeaks(reference, index2wavelength(coeffs, v));
 
         // return cost
         return fCost;
 #else
-        return 1.0 - getCalibrationModelR2(coeffs, rPeakIndices, rPeakWavelengths);
+        return 1.0 - getCalibrationModelR2(coeffs, rPeakIndices, reference);
 #endif
     };
 
     // use fminsearch to optimize cost function
-    return globalsearch<N>(std::bind(fminsearch<N>, std::placeholders::_1, std::placeholders::_2, 0, 1e-4, 1e-4), cost, pConstraintsFunction, rMinVector, rMaxVector, nNumSamples);
+    auto local_search = [&](std::function< double(const std::array<double, N>&)>, const std::array<double, N>& start)
+    {
+        return fminsearch_fast<N>(cost, start, 0, 1e-4, 1e-4);
+    };
+
+    return globalsearch<N>(local_search, cost, pConstraintsFunction, rMinVector, rMaxVector, nNumSamples);
+}
+
+// fit the first nTerms coefficients of a 'N' degree polynomial to matched peaks by linear least squares, others are left to zero
+template<size_t N> std::array<double, N> fitCalibrationModel(const vector_t& rPeakIndices, const vector_t& rPeakWavelengths, size_t nTerms = N)
+{
+    nTerms = min(nTerms, N);
+
+    // design matrix of Legendre polynomials
+    Matrix A(nTerms, rPeakIndices.size());
+
+    for (size_t i = 0; i < rPeakIndices.size(); i++)
+        for (size_t k = 0; k < nTerms; k++)
+            A(k, i) = legendre((unsigned int)k, rPeakIndices[i]);
+
+    auto x = lstsq(A, rPeakWavelengths);
+
+    // copy solution
+    std::array<double, N> ret;
+
+    for (size_t k = 0; k < N; k++)
+        ret[k] = (k < nTerms) ? x[k] : 0;
+
+    return ret;
+}
+
+// refined calibration, with covariance of the coefficients
+template<size_t N> struct CalibrationFit
+{
+    CalibrationFit(void) : covariance(N, N)
+    {
+        this->coeffs.fill(0);
+        this->fRMS = 0;
+        this->nPeaks = 0;
+        this->nIterations = 0;
+        this->bConverged = false;
+        this->bCovariance = false;
+    }
+
+    std::array<double, N> coeffs;
+    Matrix covariance;
+
+    double fRMS;
+    size_t nPeaks, nIterations;
+    bool bConverged;
+    bool bCovariance;       // false if covariance could not be estimated and was left zero
+};
+
+/*
+ *  Levenberg-Marquardt refinement of a calibration
+ *
+ *  The attribution of the peaks to their closest line is taken from the given model and kept fixed, peaks further
+ *  than CALIBRATION_REFINE_THRESHOLD being left out, so that the cost is a smooth sum of squared residuals instead
+ *  of the piecewise distance to the closest line. The Jacobian is the Legendre basis at each peak. Covariance is
+ *  s inv(J'J), with s the residual variance, and stays zero with bCovariance unset when there are not more peaks
+ *  than coefficients or when J'J is singular.
+ */
+template<size_t N> CalibrationFit<N> refineCalibrationModel(const std::array<double, N>& rModelCoeffs, const vector_t& rPeakIndices, const PeakIndex& rPeakWavelengths)
+{
+    CalibrationFit<N> ret;
+
+    ret.coeffs = rModelCoeffs;
+
+    // lock attribution
+    std::vector<std::array<double, N>> jacobian;
+    vector_t lines;
+
+    for (auto& v : rPeakIndices)
+    {
+        double fProj = index2wavelength(rModelCoeffs, v);
+        double fLine = rPeakWavelengths.closest(fProj);
+
+        if (fabs(fLine - fProj) > CALIBRATION_REFINE_THRESHOLD)
+            continue;
+
+        jacobian.emplace_back(legendre_basis<N>(v));
+        lines.emplace_back(fLine);
+    }
+
+    size_t m = lines.size();
+
+    ret.nPeaks = m;
+
+    if (m <= N)
+        return ret;
+
+    // sum of squared residuals
+    auto cost = [&](const std::array<double, N>& c)
+    {
+        double fSum = 0;
+
+        for (size_t i = 0; i < m; i++)
+        {
+            double r = lines[i];
+
+            for (size_t k = 0; k < N; k++)
+                r -= c[k] * jacobian[i][k];
+
+            fSum += r * r;
+        }
+
+        return fSum;
+    };
+
+    // normal matrix does not depend on the coefficients
+    Matrix JtJ(N, N), A(N, N);
+
+    for (size_t i = 0; i < m; i++)
+        for (size_t a = 0; a < N; a++)
+            for (size_t b = 0; b < N; b++)
+                JtJ(b, a) += jacobian[i][a] * jacobian[i][b];
+
+    CholeskyDecomposition cholesky;
+
+    vector_t Jtr(N);
+    std::array<double, N> candidate;
+
+    double fCost = cost(ret.coeffs);
+    double fLambda = 1e-3;
+
+    while (ret.nIterations < CALIBRATION_REFINE_MAX_ITERATIONS && !ret.bConverged)
+    {
+        ret.nIterations++;
+
+        for (size_t a = 0; a < N; a++)
+            Jtr[a] = 0;
+
+        for (size_t i = 0; i < m; i++)
+        {
+            double r = lines[i];
+
+            for (size_t k = 0; k < N; k++)
+                r -= ret.coeffs[k] * jacobian[i][k];
+
+            for (size_t a = 0; a < N; a++)
+                Jtr[a] += jacobian[i][a] * r;
+        }
+
+        // increase damping until the step lowers the cost
+        bool bAccepted = false;
+
+        while (!bAccepted)
+        {
+            if (fLambda > CALIBRATION_REFINE_MAX_LAMBDA)
+            {
+                // no descent direction left, at a minimum within numerical precision
+                ret.bConverged = true;
+                break;
+            }
+
+            A = JtJ;
+
+            for (size_t a = 0; a < N; a++)
+                A(a, a) += fLambda * max(JtJ(a, a), 1e-12);
+
+            if (!cholesky.tryDecompose(A))
+            {
+                fLambda *= 10;
+                continue;
+            }
+
+            vector_t step = cholesky.solve(Jtr);
+
+            for (size_t a = 0; a < N; a++)
+                candidate[a] = ret.coeffs[a] + step[a];
+
+            double fNewCost = cost(candidate);
+
+            if (fNewCost <= fCost)
+            {
+                ret.bConverged = (fCost - fNewCost) <= CALIBRATION_REFINE_TOLERANCE * fCost;
+                bAccepted = true;
+
+                ret.coeffs = candidate;
+                fCost = fNewCost;
+                fLambda = max(CALIBRATION_REFINE_MIN_LAMBDA, fLambda / 10);
+            }
+            else
+                fLambda *= 10;
+        }
+    }
+
+    ret.fRMS = sqrt(fCost / (double)m);
+
+    // covariance, J'J is positive definite unless the peaks do not constrain all coefficients
+    if (cholesky.tryDecompose(JtJ))
+    {
+        ret.covariance = cholesky.inverse();
+        ret.bCovariance = true;
+    }
+    else
+    {
+        LUDecomposition lu(JtJ);
+
+        if (!lu.isSingular())
+        {
+            ret.covariance = lu.inverse();
+            ret.bCovariance = true;
+        }
+    }
+
+    if (ret.bCovariance)
+        ret.covariance *= fCost / (double)(m - N);
+
+    return ret;
+}
+
+// previous solution with the peaks it was found from
+struct CalibrationWarmStart
+{
+    vector_t coeffs;
+    vector_t peaks;
+};
+
+/*
+ *  warm start of a calibration from a previous one
+ *
+ *  Peaks drift by about the same amount between sessions, so each peak is paired with the closest previous peak once
+ *  their median offset is removed, and takes the line closest to the projection of its partner by the previous model.
+ *  The model is fitted to these pairs and polished by refineCalibrationModel(). Without previous peaks, or with too few
+ *  pairs, the previous model is refined as is.
+ */
+template<size_t N> CalibrationFit<N> warmStartCalibrationModel(const CalibrationWarmStart& rWarmStart, const vector_t& rPeakIndices, const PeakIndex& rPeakWavelengths)
+{
+    std::array<double, N> coeffs;
+
+    for (size_t k = 0; k < N; k++)
+        coeffs[k] = (k < rWarmStart.coeffs.size()) ? rWarmStart.coeffs[k] : 0;
+
+    if (rWarmStart.peaks.size() > 0)
+    {
+        PeakIndex previous(rWarmStart.peaks);
+
+        // median drift
+        vector_t offsets;
+
+        for (auto& v : rPeakIndices)
+        {
+            double fOffset = v - previous.closest(v);
+
+            if (fabs(fOffset) <= CALIBRATION_WARMSTART_MAX_SHIFT)
+                offsets.emplace_back(fOffset);
+        }
+
+        if (offsets.size() > N)
+        {
+            std::nth_element(offsets.begin(), offsets.begin() + offsets.size() / 2, offsets.end());
+
+            double fShift = offsets[offsets.size() / 2];
+
+            // pair peaks and attribute lines through the previous model
+            vector_t x, y;
+
+            for (auto& v : rPeakIndices)
+            {
+                double fPrevious = previous.closest(v - fShift);
+
+                if (fabs(v - fShift - fPrevious) > CALIBRATION_WARMSTART_TOLERANCE)
+                    continue;
+
+                double fProj = index2wavelength(coeffs, fPrevious);
+                double fLine = rPeakWavelengths.closest(fProj);
+
+                if (fabs(fLine - fProj) > CALIBRATION_REFINE_THRESHOLD)
+                    continue;
+
+                x.emplace_back(v);
+                y.emplace_back(fLine);
+            }
+
+            if (x.size() > N)
+            {
+                try
+                {
+                    coeffs = fitCalibrationModel<N>(x, y);
+                }
+                catch (IException&) {}
+            }
+        }
+    }
+
+    return refineCalibrationModel<N>(coeffs, rPeakIndices, rPeakWavelengths);
+}
+
+// return true if a refined calibration attributes enough of the peaks with a low enough RMS to be trusted as a warm start
+template<size_t N> bool isCalibrationFitReliable(const CalibrationFit<N>& rFit, size_t nNumPeaks, double fMaxRMS = CALIBRATION_WARMSTART_MAX_RMS)
+{
+    if (rFit.nPeaks <= N || (double)rFit.nPeaks < CALIBRATION_WARMSTART_MIN_PEAKS * (double)nNumPeaks)
+        return false;
+
+    return rFit.fRMS <= fMaxRMS;
+}
+
+// return standard deviation of the wavelength projected from an index, given the covariance of the coefficients
+static double getCalibrationModelUncertainty(const Matrix& rCovariance, double fIndex)
+{
+    size_t n = rCovariance.numRows();
+
+    if (rCovariance.numColumns() != n)
+        return 0;
+
+    vector_t basis(n);
+
+    for (size_t k = 0; k < n; k++)
+        basis[k] = legendre((unsigned int)k, fIndex);
+
+    double fVariance = 0;
+
+    for (size_t a = 0; a < n; a++)
+        for (size_t b = 0; b < n; b++)
+            fVariance += basis[a] * rCovariance(b, a) * basis[b];
+
+    return sqrt(max(0.0, fVariance));
 }
 
 // interface to make global optimization generic
@@ -152,6 +527,12 @@ public:
 		this->m_bSolutionFound = false;
 		this->m_numTests = 0;
 		this->m_maxTests = 0;
+
+		this->m_nSeed = 0;
+		this->m_bEarlyExit = true;
+
+		this->m_fWarmStartMaxRMS = CALIBRATION_WARMSTART_MAX_RMS;
+		this->m_bWarmStarted = false;
 	}
 
 	virtual vector_t getSolution(size_t nFinalSize) const = 0;
@@ -174,16 +555,86 @@ public:
 		return this->m_maxTests;
 	}
 
+	// set seed of the starting points, same seed gives same solution
+	void setSeed(unsigned long long nSeed)
+	{
+		this->m_nSeed = nSeed;
+	}
+
+	// enable stopping once the best cost stops improving
+	void setEarlyExit(bool bEarlyExit)
+	{
+		this->m_bEarlyExit = bEarlyExit;
+	}
+
+	// set previous solutions tried before the global search, which is skipped if one of them fits most peaks with an RMS below fMaxRMS
+	void setWarmStarts(const std::vector<CalibrationWarmStart>& rWarmStarts, double fMaxRMS = CALIBRATION_WARMSTART_MAX_RMS)
+	{
+		this->m_warmStarts = rWarmStarts;
+		this->m_fWarmStartMaxRMS = fMaxRMS;
+	}
+
+	// return true if the solution was found from a previous one
+	bool isWarmStarted(void) const
+	{
+		return this->m_bWarmStarted;
+	}
+
+	// return covariance of the solution coefficients, empty if the solution was not refined or its covariance is singular
+	Matrix getCovariance(void) const
+	{
+		// wait for thread to be finished
+		if (isRunning())
+			wait();
+
+		return this->m_covariance;
+	}
+
 protected:
 
-	// start processing
-	virtual void onStart(void) override
+	// clear solution and counters, called from onStart so that a restarted thread does not stop on the previous results
+	void reset(void)
 	{
 		// set no solution flag
 		this->m_bSolutionFound = false;
 
 		// clear number of tests
 		this->m_numTests = 0;
+
+		// clear covariance
+		this->m_covariance = Matrix();
+
+		// clear warm start flag
+		this->m_bWarmStarted = false;
+	}
+
+	// try previous solutions and keep the one of lowest RMS among those respecting the constraints and fitting enough peaks
+	template<size_t N> bool warmStart(std::array<double, N>& rCoeffs, const std::function<bool(const std::array<double, N>&)>& pConstraintsFunction)
+	{
+		double fBestRMS = 0;
+
+		for (auto& v : this->m_warmStarts)
+		{
+			if (isQuitting())
+				break;
+
+			auto fit = warmStartCalibrationModel<N>(v, this->m_peaks, this->m_calibration_data);
+
+			if (!isCalibrationFitReliable(fit, this->m_peaks.size(), this->m_fWarmStartMaxRMS) || !pConstraintsFunction(fit.coeffs))
+				continue;
+
+			if (!this->m_bWarmStarted || fit.fRMS < fBestRMS)
+			{
+				fBestRMS = fit.fRMS;
+
+				rCoeffs = fit.coeffs;
+
+				this->m_covariance = fit.bCovariance ? fit.covariance : Matrix();
+				this->m_bWarmStarted = true;
+			}
+		}
+
+		return this->m_bWarmStarted;
 	}
 
 	// stop processing
@@ -192,10 +643,20 @@ protected:
 
 	}
 
-	vector_t m_peaks, m_calibration_data;
+	vector_t m_peaks;
+	PeakIndex m_calibration_data;
+
+	Matrix m_covariance;
+
+	std::vector<CalibrationWarmStart> m_warmStarts;
+	double m_fWarmStartMaxRMS;
+	std::atomic<bool> m_bWarmStarted;
 
 	std::atomic<bool> m_bSolutionFound;
 	std::atomic<int> m_numTests, m_maxTests;
+
+	unsigned long long m_nSeed;
+	bool m_bEarlyExit;
 };
 
 // static solution
@@ -230,7 +691,17 @@ private:
 	vector_t m_solution;
 };
 
-// global optimization thread class
+/*
+ *	global optimization thread class
+ *
+ *	A single run() hands the starts to a pool of workers, one per core. Each worker claims test numbers from an atomic
+ *	counter, so that no start is done twice and m_numTests only counts finished starts, and takes the point of that number
+ *	in a Sobol sequence seeded by m_nSeed. Every result is written once to the slot of its test and the index of the best
+ *	slot is reduced with compare-and-swap, ties going to the lowest test so that the outcome does not depend on scheduling.
+ *	With early exit, workers stop claiming tests once the best cost has not improved for globalsearch_patience() tests.
+ *	The winner is then polished by refineCalibrationModel() with its attribution of peaks to lines held fixed. Previous
+ *	solutions given by setWarmStarts() are tried first, and the search is skipped if one of them still fits the peaks.
+ */
 template<size_t N> class GlobalOptimizationThread : public IGlobalOptimizationThread
 {
 public:
@@ -244,6 +715,11 @@ public:
 			this->m_minBounds[i] = 0;
 			this->m_maxBounds[i] = 0;
 		}
+
+		this->m_nextTest = 0;
+		this->m_bestTest = -1;
+		this->m_lastImprovement = 0;
+		this->m_bConverged = false;
 	}
 
 	using array_t = std::array<double, N>;
@@ -260,7 +736,9 @@ public:
 			throw;
 
 		// prepare solution
-		vector_t ret(this->m_bestCoefficients.begin(), this->m_bestCoefficients.end());
+		auto& best = this->m_results[this->m_bestTest];
+
+		vector_t ret(best.coeffs.begin(), best.coeffs.end());
 
 		for (size_t i = ret.size(); i < nFinalSize; i++)
 			ret.emplace_back(0);
@@ -276,8 +754,15 @@ protected:
 
 private:
 
+	// result of a single start, written once by the worker that claimed it
+	struct Result
+	{
+		array_t coeffs;
+		double fCost;
+	};
+
 	// cost function
-	double cost(const array_t& coeffs)
+	double cost(const array_t& coeffs) const
 	{
 #if 1
 		// initialize cost to zero
@@ -297,42 +782,152 @@ private:
 	// stop condition
 	virtual bool stopCondition(void) const override
 	{
-		return (this->m_numTests > this->m_maxTests);
+		return (this->m_numTests >= this->m_maxTests) || this->m_bConverged;
 	}
 
-	// process solution
+	// clear search before the thread starts
+	virtual void onStart(void) override
+	{
+		reset();
+
+		this->m_nextTest = 0;
+		this->m_bestTest = -1;
+		this->m_lastImprovement = 0;
+		this->m_bConverged = false;
+	}
+
+	// process all tests
 	virtual void run(void) override
 	{
-		// increment number of tests
-		this->m_numTests++;
+		this->m_results.resize((size_t)max(1, (int)this->m_maxTests));
 
-		// randomize starting position
-		auto start_coeffs = randomize(this->m_minBounds, this->m_maxBounds);
+		// skip global search if a previous solution still fits
+		array_t warm_coeffs;
 
-		// use local search method
-		auto fit_coeffs = fminsearch<N>(std::bind(&GlobalOptimizationThread<N>::cost, this, std::placeholders::_1), start_coeffs);
+		if (warmStart<N>(warm_coeffs, [this](const array_t& coeffs) { return inConstraints(coeffs); }))
+		{
+			auto& result = this->m_results[0];
+
+			result.coeffs = warm_coeffs;
+			result.fCost = cost(warm_coeffs);
+
+			this->m_bestTest = 0;
+			this->m_numTests = (int)this->m_maxTests;
+			this->m_bConverged = true;
+			this->m_bSolutionFound = true;
 
-		// skip if not in bounds
-		if (!inConstraints(fit_coeffs))
 			return;
+		}
 
-		// compute cost
-		auto fCost = cost(fit_coeffs);
+		size_t nWorkers = parallel_threads();
 
-		// save best
-		if (!this->m_bSolutionFound || fCost < this->m_fBestCost)
+		parallel_for(nWorkers, 1, [&](size_t nBegin, size_t nEnd)
 		{
-			this->m_bestCoefficients = fit_coeffs;
-			this->m_fBestCost = fCost;
+			for (size_t w = nBegin; w < nEnd; w++)
+				work();
+		});
 
-			this->m_bSolutionFound = true;
+		// refine the best start with the attribution it found
+		if (this->m_bSolutionFound && !isQuitting())
+			polish(this->m_results[this->m_bestTest]);
+	}
+
+	// refine result by Levenberg-Marquardt, keeping it only if it still respects the constraints
+	void polish(Result& rResult)
+	{
+		auto fit = refineCalibrationModel<N>(rResult.coeffs, this->m_peaks, this->m_calibration_data);
+
+		if (fit.nPeaks <= N || !inConstraints(fit.coeffs))
+			return;
+
+		rResult.coeffs = fit.coeffs;
+		rResult.fCost = cost(fit.coeffs);
+
+		this->m_covariance = fit.bCovariance ? fit.covariance : Matrix();
+	}
+
+	// worker loop, returns when all tests are claimed, when the search has converged or when asked to quit
+	void work(void)
+	{
+		SobolSequence<N> sequence(this->m_nSeed);
+
+		int nPatience = (int)globalsearch_patience((size_t)max(0, (int)this->m_maxTests));
+
+		auto cost_function = [this](const array_t& coeffs) { return cost(coeffs); };
+
+		while (!isQuitting())
+		{
+			// claim a test
+			int nTest = this->m_nextTest++;
+
+			if (nTest >= this->m_maxTests)
+				break;
+
+			// stop if best cost did not improve for a while
+			if (this->m_bEarlyExit && this->m_bSolutionFound && nTest - this->m_lastImprovement > nPatience)
+			{
+				this->m_bConverged = true;
+				break;
+			}
+
+			// starting position
+			auto start_coeffs = sequence.sample((unsigned long long)nTest, this->m_minBounds, this->m_maxBounds);
+
+			// use local search method
+			auto fit_coeffs = fminsearch_fast<N>(cost_function, start_coeffs);
+
+			// keep if in bounds
+			if (inConstraints(fit_coeffs))
+			{
+				auto& result = this->m_results[nTest];
+
+				result.coeffs = fit_coeffs;
+				result.fCost = cost(fit_coeffs);
+
+				publish(nTest);
+			}
+
+			// increment number of tests
+			this->m_numTests++;
+		}
+	}
+
+	// make test the best one if it beats the current best
+	void publish(int nTest)
+	{
+		auto better = [&](int a, int b)
+		{
+			if (this->m_results[a].fCost != this->m_results[b].fCost)
+				return this->m_results[a].fCost < this->m_results[b].fCost;
+
+			return a < b;
+		};
+
+		int nBest = this->m_bestTest.load(std::memory_order_acquire);
+
+		while (nBest < 0 || better(nTest, nBest))
+		{
+			if (this->m_bestTest.compare_exchange_weak(nBest, nTest, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				// record last significant improvement, keeping the highest test
+				if (nBest < 0 || globalsearch_improved(this->m_results[nTest].fCost, this->m_results[nBest].fCost))
+				{
+					int nLast = this->m_lastImprovement;
+
+					while (nLast < nTest && !this->m_lastImprovement.compare_exchange_weak(nLast, nTest));
+				}
+
+				this->m_bSolutionFound = true;
+				break;
+			}
 		}
 	}
 
 	// members
-	array_t m_bestCoefficients;
+	std::vector<Result> m_results;
 
-	double m_fBestCost;
+	std::atomic<int> m_nextTest, m_bestTest, m_lastImprovement;
+	std::atomic<bool> m_bConverged;
 };
 
 // linear model
@@ -353,7 +948,7 @@ public:
 		this->m_maxBounds = { fMaxRange, 0.5 * fMaxSpan };
 
 		this->m_peaks = rPeaks;
-		this->m_calibration_data = rCalibrationData;
+		this->m_calibration_data = PeakIndex(rCalibrationData);
 	}
 
 protected:
@@ -379,11 +974,21 @@ private:
 	} m_range, m_span;
 };
 
-// cubic model
-class CubicModelThread : public GlobalOptimizationThread<4>
+/*
+ *	polynomial model of N coefficients
+ *
+ *	Bounds and constraints are generated from the settings for any order: c[0] within the range, c[1] within half the
+ *	span, and every higher coefficient within the distortion, whose sum of absolute values must lie between its
+ *	minimum and maximum. The number of starts stays that of a cubic model, early exit being relied on for higher orders.
+ */
+template<size_t N> class PolynomialModelThread : public GlobalOptimizationThread<N>
 {
 public:
-	CubicModelThread(const vector_t& rPeaks, const vector_t& rCalibrationData, double fMinRange, double fMaxRange, double fMinSpan, double fMaxSpan, double fMinDistortion, double fMaxDistortion, size_t nNumSampling) : GlobalOptimizationThread()
+	static_assert(N >= 2 && N <= CALIBRATION_MAX_COEFFS, "Unsupported number of coefficients!");
+
+	using typename GlobalOptimizationThread<N>::array_t;
+
+	PolynomialModelThread(const vector_t& rPeaks, const vector_t& rCalibrationData, double fMinRange, double fMaxRange, double fMinSpan, double fMaxSpan, double fMinDistortion, double fMaxDistortion, size_t nNumSampling) : GlobalOptimizationThread<N>()
 	{
 		this->m_range.fMin = fMinRange;
 		this->m_range.fMax = fMaxRange;
@@ -394,13 +999,27 @@ public:
 		this->m_distortion.fMin = fMinDistortion;
 		this->m_distortion.fMax = fMaxDistortion;
 
-		this->m_maxTests = (int)(nNumSampling * nNumSampling * nNumSampling * nNumSampling);
+		size_t nMaxTests = 1;
 
-		this->m_minBounds = { fMinRange, 0.5 * fMinSpan, -fMaxDistortion, -fMaxDistortion };
-		this->m_maxBounds = { fMaxRange, 0.5 * fMaxSpan, +fMaxDistortion, +fMaxDistortion };
+		for (size_t k = 0; k < min(N, (size_t)4); k++)
+			nMaxTests *= nNumSampling;
+
+		this->m_maxTests = (int)nMaxTests;
+
+		this->m_minBounds[0] = fMinRange;
+		this->m_maxBounds[0] = fMaxRange;
+
+		this->m_minBounds[1] = 0.5 * fMinSpan;
+		this->m_maxBounds[1] = 0.5 * fMaxSpan;
+
+		for (size_t k = 2; k < N; k++)
+		{
+			this->m_minBounds[k] = -fMaxDistortion;
+			this->m_maxBounds[k] = +fMaxDistortion;
+		}
 
 		this->m_peaks = rPeaks;
-		this->m_calibration_data = rCalibrationData;
+		this->m_calibration_data = PeakIndex(rCalibrationData);
 	}
 
 protected:
@@ -413,7 +1032,110 @@ protected:
 			return false;
 
 		// check distortions
-		double fDistortion = fabs(coeffs[2]) + fabs(coeffs[3]);
+		if (N > 2)
+		{
+			double fDistortion = 0;
+
+			for (size_t k = 2; k < N; k++)
+				fDistortion += fabs(coeffs[k]);
+
+			if (fDistortion < this->m_distortion.fMin || fDistortion > this->m_distortion.fMax)
+				return false;
+		}
+
+		// check span
+		if (coeffs[1] < (0.5 * this->m_span.fMin) || coeffs[1] > (0.5 * this->m_span.fMax))
+			return false;
+
+		return true;
+	}
+
+private:
+
+	struct
+	{
+		double fMin, fMax;
+	} m_range, m_span, m_distortion;
+};
+
+// cubic model
+using CubicModelThread = PolynomialModelThread<4>;
+
+/*
+ *	line matching model thread
+ *
+ *	Solves the calibration directly instead of sampling the coefficients. The ratio (p[j] - p[i]) / (p[k] - p[i]) of three
+ *	neighbouring peaks hardly depends on the dispersion, so each triplet of detected peaks is paired with the triplets of
+ *	reference lines of similar ratio. Every pairing is a minimal set giving a linear model, scored by the truncated
+ *	squared distance of all peaks to their closest line (MSAC). The best distinct hypotheses are then refined: peaks are
+ *	attributed to their closest line nearest to the triplet first, refitting the Legendre coefficients by linear least
+ *	squares with a degree growing with the number of attributed peaks, and the full model is iterated until the
+ *	attribution is stable. Hypotheses are visited in an order shuffled by m_nSeed and capped to the sampling budget, so
+ *	that a run is reproducible.
+ */
+template<size_t N> class LineMatchingModelThread : public IGlobalOptimizationThread
+{
+public:
+	static_assert(N >= 2, "Model must be at least linear!");
+
+	using array_t = std::array<double, N>;
+
+	LineMatchingModelThread(const vector_t& rPeaks, const vector_t& rCalibrationData, double fMinRange, double fMaxRange, double fMinSpan, double fMaxSpan, double fMinDistortion, double fMaxDistortion, size_t nNumSampling)
+	{
+		this->m_range.fMin = fMinRange;
+		this->m_range.fMax = fMaxRange;
+
+		this->m_span.fMin = fMinSpan;
+		this->m_span.fMax = fMaxSpan;
+
+		this->m_distortion.fMin = (N > 2) ? fMinDistortion : 0;
+		this->m_distortion.fMax = (N > 2) ? fMaxDistortion : 0;
+
+		// same budget as the cubic model, hypotheses are much cheaper than starts so it is seldom reached
+		this->m_nBudget = nNumSampling * nNumSampling * nNumSampling * nNumSampling;
+
+		this->m_peaks = rPeaks;
+		this->m_calibration_data = PeakIndex(rCalibrationData);
+
+		std::sort(this->m_peaks.begin(), this->m_peaks.end());
+
+		this->m_solution.fill(0);
+		this->m_bDone = false;
+	}
+
+	// retrieve solution
+	virtual vector_t getSolution(size_t nFinalSize) const override
+	{
+		// wait for thread to be finished
+		if (isRunning())
+			wait();
+
+		// return error if no solution found
+		if (!hasSolution())
+			throw;
+
+		vector_t ret(this->m_solution.begin(), this->m_solution.end());
+
+		for (size_t i = ret.size(); i < nFinalSize; i++)
+			ret.emplace_back(0);
+
+		return ret;
+	}
+
+protected:
+
+	// return true if solution respect constraints
+	bool inConstraints(const array_t& coeffs) const
+	{
+		// plot must range from min range to max range
+		if ((coeffs[0] - coeffs[1]) < this->m_range.fMin || (coeffs[0] + coeffs[1]) > this->m_range.fMax)
+			return false;
+
+		// check distortions
+		double fDistortion = 0;
+
+		for (size_t k = 2; k < N; k++)
+			fDistortion += fabs(coeffs[k]);
 
 		if (fDistortion < this->m_distortion.fMin || fDistortion > this->m_distortion.fMax)
 			return false;
@@ -427,6 +1149,356 @@ protected:
 
 private:
 
+	// pairing of three detected peaks with three reference lines
+	struct Hypothesis
+	{
+		unsigned short peaks[3], lines[3];
+	};
+
+	// candidate kept for refinement
+	struct Candidate
+	{
+		array_t coeffs;
+		double fCenter;
+		double fCost;
+	};
+
+	// triplet of indices with its spacing ratio
+	struct Triplet
+	{
+		double fRatio;
+		unsigned short indices[3];
+	};
+
+	// stop once solved
+	virtual bool stopCondition(void) const override
+	{
+		return this->m_bDone;
+	}
+
+	// clear solution before the thread starts
+	virtual void onStart(void) override
+	{
+		reset();
+
+		this->m_bDone = false;
+	}
+
+	// truncated squared distance of all peaks to their closest line
+	double cost(const array_t& coeffs) const
+	{
+		const double fThreshold2 = RANSAC_INLIER_THRESHOLD * RANSAC_INLIER_THRESHOLD;
+
+		double fCost = 0;
+
+		for (auto& v : this->m_peaks)
+		{
+			double d = this->m_calibration_data.distance(index2wavelength(coeffs, v));
+
+			fCost += min(d * d, fThreshold2);
+		}
+
+		return fCost;
+	}
+
+	// return triplets of neighbouring positions sorted by ratio
+	static std::vector<Triplet> triplets(const vector_t& rPositions, size_t nWindow)
+	{
+		std::vector<Triplet> ret;
+
+		size_t n = min(rPositions.size(), (size_t)USHRT_MAX);
+
+		for (size_t i = 0; i < n; i++)
+		{
+			for (size_t j = i + 1; j < n && j <= i + nWindow; j++)
+			{
+				for (size_t k = j + 1; k < n && k <= j + nWindow; k++)
+				{
+					double fLength = rPositions[k] - rPositions[i];
+
+					if (fLength <= 0)
+						continue;
+
+					Triplet triplet;
+
+					triplet.fRatio = (rPositions[j] - rPositions[i]) / fLength;
+					triplet.indices[0] = (unsigned short)i;
+					triplet.indices[1] = (unsigned short)j;
+					triplet.indices[2] = (unsigned short)k;
+
+					ret.emplace_back(triplet);
+				}
+			}
+		}
+
+		std::sort(ret.begin(), ret.end(), [](const Triplet& a, const Triplet& b) { return a.fRatio < b.fRatio; });
+
+		return ret;
+	}
+
+	// pair peak triplets with line triplets of similar ratio
+	std::vector<Hypothesis> enumerate(void) const
+	{
+		auto peak_triplets = triplets(this->m_peaks, RANSAC_PEAK_WINDOW);
+		auto line_triplets = triplets(this->m_calibration_data.positions(), RANSAC_LINE_WINDOW);
+
+		std::vector<Hypothesis> ret;
+
+		for (auto& p : peak_triplets)
+		{
+			auto it = std::lower_bound(line_triplets.begin(), line_triplets.end(), p.fRatio - RANSAC_RATIO_TOLERANCE, [](const Triplet& a, double fRatio) { return a.fRatio < fRatio; });
+
+			for (; it != line_triplets.end() && it->fRatio <= p.fRatio + RANSAC_RATIO_TOLERANCE; it++)
+			{
+				Hypothesis hypothesis;
+
+				for (size_t k = 0; k < 3; k++)
+				{
+					hypothesis.peaks[k] = p.indices[k];
+					hypothesis.lines[k] = it->indices[k];
+				}
+
+				ret.emplace_back(hypothesis);
+			}
+		}
+
+		return ret;
+	}
+
+	// linear model through the three correspondences of an hypothesis
+	array_t solve(const Hypothesis& rHypothesis) const
+	{
+		auto& lines = this->m_calibration_data.positions();
+
+		vector_t x(3), y(3);
+
+		for (size_t k = 0; k < 3; k++)
+		{
+			x[k] = this->m_peaks[rHypothesis.peaks[k]];
+			y[k] = lines[rHypothesis.lines[k]];
+		}
+
+		return fitCalibrationModel<N>(x, y, 2);
+	}
+
+	// true if local dispersion of a linear hypothesis can be reached within the span and distortion constraints
+	bool plausible(const array_t& coeffs) const
+	{
+		// largest slope the distortion terms can add, |P'k(x)| <= k (k + 1) / 2 on [-1, 1]
+		double fMargin = 0;
+
+		for (size_t k = 2; k < N; k++)
+			fMargin += 0.5 * (double)(k * (k + 1));
+
+		fMargin *= this->m_distortion.fMax;
+
+		return coeffs[1] >= (0.5 * this->m_span.fMin - fMargin) && coeffs[1] <= (0.5 * this->m_span.fMax + fMargin);
+	}
+
+	// grow the assignment outwards from the hypothesis, then alternate inlier assignment and least-squares fit until stable
+	bool refine(array_t& coeffs, double fCenter) const
+	{
+		vector_t x, y;
+
+		// the linear model only holds close to the triplet, so peaks are assigned nearest first and the degree raised as the set extends
+		std::vector<size_t> order(this->m_peaks.size());
+
+		for (size_t i = 0; i < order.size(); i++)
+			order[i] = i;
+
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return fabs(this->m_peaks[a] - fCenter) < fabs(this->m_peaks[b] - fCenter); });
+
+		for (auto i : order)
+		{
+			double fProj = index2wavelength(coeffs, this->m_peaks[i]);
+			double fLine = this->m_calibration_data.closest(fProj);
+
+			if (fabs(fLine - fProj) > RANSAC_INLIER_THRESHOLD)
+				continue;
+
+			x.emplace_back(this->m_peaks[i]);
+			y.emplace_back(fLine);
+
+			size_t nTerms = min(N, max((size_t)2, x.size() / RANSAC_PEAKS_PER_TERM));
+
+			if (x.size() <= nTerms)
+				continue;
+
+			try
+			{
+				coeffs = fitCalibrationModel<N>(x, y, nTerms);
+			}
+			catch (IException&)
+			{
+				return false;
+			}
+		}
+
+		// polish with the full model
+		std::vector<size_t> inliers, last_inliers;
+
+		for (size_t nIteration = 0; nIteration < RANSAC_REFINE_ITERATIONS; nIteration++)
+		{
+			inliers.clear();
+			x.clear();
+			y.clear();
+
+			// assign peaks to their closest line
+			for (size_t i = 0; i < this->m_peaks.size(); i++)
+			{
+				double fProj = index2wavelength(coeffs, this->m_peaks[i]);
+				double fLine = this->m_calibration_data.closest(fProj);
+
+				if (fabs(fLine - fProj) > RANSAC_INLIER_THRESHOLD)
+					continue;
+
+				inliers.emplace_back(i);
+				x.emplace_back(this->m_peaks[i]);
+				y.emplace_back(fLine);
+			}
+
+			// stop once the assignment is stable
+			if (nIteration > 0 && inliers == last_inliers)
+				return true;
+
+			if (inliers.size() <= N)
+				return false;
+
+			try
+			{
+				coeffs = fitCalibrationModel<N>(x, y);
+			}
+			catch (IException&)
+			{
+				return false;
+			}
+
+			std::swap(inliers, last_inliers);
+		}
+
+		return true;
+	}
+
+	// process all hypotheses
+	virtual void run(void) override
+	{
+		// skip hypotheses if a previous solution still fits
+		if (warmStart<N>(this->m_solution, [this](const array_t& coeffs) { return inConstraints(coeffs); }))
+		{
+			this->m_maxTests = 1;
+			this->m_numTests = 1;
+			this->m_bSolutionFound = true;
+			this->m_bDone = true;
+
+			return;
+		}
+
+		auto hypotheses = enumerate();
+
+		// visit hypotheses in a reproducible random order, and within budget
+		std::mt19937_64 generator(this->m_nSeed);
+
+		std::shuffle(hypotheses.begin(), hypotheses.end(), generator);
+
+		if (hypotheses.size() > this->m_nBudget)
+			hypotheses.resize(this->m_nBudget);
+
+		this->m_maxTests = (int)hypotheses.size();
+
+		// keep best hypotheses sorted by cost
+		std::vector<Candidate> candidates;
+
+		for (auto& hypothesis : hypotheses)
+		{
+			if (isQuitting())
+				break;
+
+			this->m_numTests++;
+
+			Candidate candidate;
+
+			try
+			{
+				candidate.coeffs = solve(hypothesis);
+			}
+			catch (IException&)
+			{
+				continue;
+			}
+
+			if (!plausible(candidate.coeffs))
+				continue;
+
+			candidate.fCenter = this->m_peaks[hypothesis.peaks[1]];
+
+			candidate.fCost = cost(candidate.coeffs);
+
+			if (candidates.size() == RANSAC_REFINE_CANDIDATES && candidate.fCost >= candidates.back().fCost)
+				continue;
+
+			// keep a single hypothesis per model, so that refinement explores different assignments
+			auto same = std::find_if(candidates.begin(), candidates.end(), [&](const Candidate& c) { return fabs(c.coeffs[0] - candidate.coeffs[0]) + fabs(c.coeffs[1] - candidate.coeffs[1]) < RANSAC_INLIER_THRESHOLD; });
+
+			if (same != candidates.end())
+			{
+				if (same->fCost <= candidate.fCost)
+					continue;
+
+				candidates.erase(same);
+			}
+
+			auto it = std::upper_bound(candidates.begin(), candidates.end(), candidate.fCost, [](double fCost, const Candidate& c) { return fCost < c.fCost; });
+
+			candidates.insert(it, candidate);
+
+			if (candidates.size() > RANSAC_REFINE_CANDIDATES)
+				candidates.pop_back();
+		}
+
+		// refine and keep best solution respecting constraints
+		double fBestCost = 0;
+
+		for (auto& candidate : candidates)
+		{
+			if (isQuitting())
+				break;
+
+			auto coeffs = candidate.coeffs;
+
+			if (!refine(coeffs, candidate.fCenter) || !inConstraints(coeffs))
+				continue;
+
+			double fCost = cost(coeffs);
+
+			if (!this->m_bSolutionFound || fCost < fBestCost)
+			{
+				fBestCost = fCost;
+
+				this->m_solution = coeffs;
+				this->m_bSolutionFound = true;
+			}
+		}
+
+		// refine with the attribution of the best solution, for its covariance
+		if (this->m_bSolutionFound && !isQuitting())
+		{
+			auto fit = refineCalibrationModel<N>(this->m_solution, this->m_peaks, this->m_calibration_data);
+
+			if (fit.nPeaks > N && inConstraints(fit.coeffs))
+			{
+				this->m_solution = fit.coeffs;
+				this->m_covariance = fit.bCovariance ? fit.covariance : Matrix();
+			}
+		}
+
+		this->m_bDone = true;
+	}
+
+	array_t m_solution;
+	size_t m_nBudget;
+
+	std::atomic<bool> m_bDone;
+
 	struct
 	{
 		double fMin, fMax;
@@ -0,0 +1,174 @@
+/*
+ *	2020 (C) The Pulsar Engineering
+ *	http://www.thepulsar.be
+ *
+ *	This document is licensed under the CERN OHL-W v2 (http://ohwr.org/cernohl).
+ *
+ *	You may redistribute and modify this document under the terms of the
+ *	CERN OHL-W v2 only. This document is distributed WITHOUT ANY EXPRESS OR
+ *	IMPLIED WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY AND
+ *	FITNESS FOR APARTICULAR PURPOSE. Please refer to the CERN OHL-W v2 for
+ *	applicable conditions.
+ */
+#pragma once
+
+#include "../utils/parallel.h"
+#include "../utils/safe.h"
+
+#include "simd.h"
+
+/*
+ *	dense matrix kernels on row-major arrays
+ *
+ *	Inner loops run along rows through the SIMD kernels. Blocks are sized so that the active part of B
+ *	stays in L2 and the active segment of a row of C stays in L1. Problems above GEMM_PARALLEL_FLOPS
+ *	multiply-adds are split across threads by rows (or columns for the transposed products).
+ */
+
+// block sizes in elements
+#define GEMM_BLOCK_ROWS			64
+#define GEMM_BLOCK_INNER		128
+#define GEMM_BLOCK_COLUMNS		256
+
+#define TRANSPOSE_BLOCK			32
+
+// minimum number of multiply-adds before using threads
+#define GEMM_PARALLEL_FLOPS		(1 << 22)
+
+// return minimum number of items per thread for a given cost per item
+static size_t gemm_min_chunk(size_t nCostPerItem)
+{
+	return max((size_t)1, (size_t)GEMM_PARALLEL_FLOPS / max((size_t)1, nCostPerItem));
+}
+
+// C (m x n) = A (m x k) * B (k x n)
+template<typename Type> static void gemm_into(Type* pC, const Type* pA, const Type* pB, size_t m, size_t n, size_t k)
+{
+	const auto& kernels = simd<Type>();
+
+	parallel_for(m, gemm_min_chunk(__MULT(n, k)), [&](size_t nBegin, size_t nEnd)
+	{
+		for (size_t i = nBegin; i < nEnd; i++)
+			for (size_t j = 0; j < n; j++)
+				pC[i * n + j] = 0;
+
+		for (size_t i0 = nBegin; i0 < nEnd; i0 += GEMM_BLOCK_ROWS)
+		{
+			size_t i1 = min(nEnd, i0 + GEMM_BLOCK_ROWS);
+
+			for (size_t p0 = 0; p0 < k; p0 += GEMM_BLOCK_INNER)
+			{
+				size_t p1 = min(k, p0 + GEMM_BLOCK_INNER);
+
+				for (size_t j0 = 0; j0 < n; j0 += GEMM_BLOCK_COLUMNS)
+				{
+					size_t nc = min(n - j0, (size_t)GEMM_BLOCK_COLUMNS);
+
+					// C[i, j0:j1] += A[i, p] * B[p, j0:j1]
+					for (size_t i = i0; i < i1; i++)
+					{
+						Type* pRow = pC + i * n + j0;
+
+						for (size_t p = p0; p < p1; p++)
+						{
+							Type a = pA[i * k + p];
+
+							if (a != 0)
+								kernels.fma(pRow, pB + p * n + j0, a, pRow, nc);
+						}
+					}
+				}
+			}
+		}
+	});
+}
+
+// y (m) = A (m x n) * x (n)
+template<typename Type> static void gemv_into(Type* pY, const Type* pA, const Type* pX, size_t m, size_t n)
+{
+	const auto& kernels = simd<Type>();
+
+	parallel_for(m, gemm_min_chunk(n), [&](size_t nBegin, size_t nEnd)
+	{
+		for (size_t i = nBegin; i < nEnd; i++)
+			pY[i] = (n > 0) ? kernels.dot(pA + i * n, pX, n) : 0;
+	});
+}
+
+// y (n) = A^T * x for A (m x n) and x (m), without transposing A
+template<typename Type> static void gemtv_into(Type* pY, const Type* pA, const Type* pX, size_t m, size_t n)
+{
+	const auto& kernels = simd<Type>();
+
+	// threads own disjoint column ranges so that no reduction is needed
+	parallel_for(n, gemm_min_chunk(m), [&](size_t nBegin, size_t nEnd)
+	{
+		for (size_t j = nBegin; j < nEnd; j++)
+			pY[j] = 0;
+
+		for (size_t i = 0; i < m; i++)
+			if (pX[i] != 0)
+				kernels.fma(pY + nBegin, pA + i * n + nBegin, pX[i], pY + nBegin, nEnd - nBegin);
+	});
+}
+
+// C (n x n) = A^T * A for A (m x n), without transposing A
+template<typename Type> static void syrk_into(Type* pC, const Type* pA, size_t m, size_t n)
+{
+	const auto& kernels = simd<Type>();
+
+	// compute upper triangle, rows of C are interleaved across threads to balance the triangle
+	size_t nThreads = min(parallel_threads(), max((size_t)1, __MULT(__MULT(m, n), n) / (2 * GEMM_PARALLEL_FLOPS)));
+
+	parallel_for(nThreads, 1, [&](size_t nBegin, size_t nEnd)
+	{
+		for (size_t t = nBegin; t < nEnd; t++)
+		{
+			for (size_t i = t; i < n; i += nThreads)
+				for (size_t j = i; j < n; j++)
+					pC[i * n + j] = 0;
+
+			for (size_t r0 = 0; r0 < m; r0 += GEMM_BLOCK_INNER)
+			{
+				size_t r1 = min(m, r0 + GEMM_BLOCK_INNER);
+
+				// C[i, i:n] += A[r, i] * A[r, i:n]
+				for (size_t i = t; i < n; i += nThreads)
+				{
+					Type* pRow = pC + i * n + i;
+
+					for (size_t r = r0; r < r1; r++)
+					{
+						Type a = pA[r * n + i];
+
+						if (a != 0)
+							kernels.fma(pRow, pA + r * n + i, a, pRow, n - i);
+					}
+				}
+			}
+		}
+	});
+
+	// mirror to lower triangle
+	for (size_t i = 0; i < n; i++)
+		for (size_t j = 0; j < i; j++)
+			pC[i * n + j] = pC[j * n + i];
+}
+
+// dst (n x m) = src^T for src (m x n), by tiles to keep both sides in cache
+template<typename Type> static void transpose_into(Type* pDst, const Type* pSrc, size_t m, size_t n)
+{
+	for (size_t i0 = 0; i0 < m; i0 += TRANSPOSE_BLOCK)
+	{
+		size_t i1 = min(m, i0 + TRANSPOSE_BLOCK);
+
+		for (size_t j0 = 0; j0 < n; j0 += TRANSPOSE_BLOCK)
+		{
+			size_t j1 = min(n, j0 + TRANSPOSE_BLOCK);
+
+			for (size_t i = i0; i < i1; i++)
+				for (size_t j = j0; j < j1; j++)
+					pDst[j * m + i] = pSrc[i * n + j];
+		}
+	}
+}
@@ -17,6 +17,7 @@
 #include "../utils/exception.h"
 #include "../utils/safe.h"
 
+#include "gemm.h"
 #include "map.h"
 #include "vector.h"
 
@@ -123,6 +124,16 @@ public:
 	}
 };
 
+// MatrixNotPositiveDefiniteException exception class
+class MatrixNotPositiveDefiniteException : public IException
+{
+public:
+	virtual std::string toString(void) const override
+	{
+		return "Matrix is not symmetric positive definite!";
+	}
+};
+
 // NullVectorException exception class
 class NullVectorException : public IException
 {
@@ -253,9 +264,8 @@ public:
 	{
 		Matrix ret(getHeight(), getWidth());
 
-		for (size_t i = 0; i < getWidth(); i++)
-			for (size_t j = 0; j < getHeight(); j++)
-				ret(j, i) = this->operator()(i, j);
+		if (isValid())
+			transpose_into(ret.data(), data(), getHeight(), getWidth());
 
 		return ret;
 	}
@@ -299,34 +309,7 @@ public:
 	}
 
 	// compute determinant
-	double determinant(void) const
-	{
-		// trigger error if at least one dimension is null
-		if (numRows() == 0 || numColumns() == 0)
-			throwException(MatrixWrongSizeException, numRows(), numColumns());
-
-		// special case for size 1
-		if (numRows() == 1 && numColumns() == 1)
-			return this->operator()(0, 0);
-
-		// otherelse apply formula by browsing columns
-		double fSum = 0;
-
-		for (size_t x = 0; x < numColumns(); x++)
-		{
-			// compute minor of current column
-			auto fTemp = comatrix(x, 0).determinant();
-
-			// add to sum
-			if ((x % 2) == 0)
-				fSum += this->operator()(x, 0) * fTemp;
-			else
-				fSum -= this->operator()(x, 0) * fTemp;
-		}
-
-		// return sum
-		return fSum;
-	}
+	double determinant(void) const;
 
 	// compute minor matrix
 	auto minor(void) const
@@ -486,14 +469,25 @@ static auto operator*(const Matrix& rA, const Matrix& rB)
 
 	Matrix ret(rA.numRows(), rB.numColumns());
 
-	for (size_t i = 0; i < ret.numColumns(); i++)
-		for (size_t j = 0; j < ret.numRows(); j++)
-		{
-			ret(i, j) = 0;
+	if (ret.numRows() == 0 || ret.numColumns() == 0 || rA.numColumns() == 0)
+		return ret;
 
-			for (size_t k = 0; k < rA.numColumns(); k++)
-				ret(i, j) += rA(k, i) * rB(j, k);
-		}
+	// ret(i, j) = sum_k rA(k, i) * rB(j, k), i.e. the row-major product stored transposed
+	auto product = scratch<double>(__MULT(rA.numRows(), rB.numColumns()));
+
+	gemm_into(product->data(), rA.data(), rB.data(), rA.numRows(), rB.numColumns(), rA.numColumns());
+	transpose_into(ret.data(), product->data(), rA.numRows(), rB.numColumns());
+
+	return ret;
+}
+
+// A^T * A computed without forming the transpose
+static auto gram(const Matrix& rA)
+{
+	Matrix ret(rA.numColumns(), rA.numColumns());
+
+	if (rA.numRows() > 0 && rA.numColumns() > 0)
+		syrk_into(ret.data(), rA.data(), rA.numRows(), rA.numColumns());
 
 	return ret;
 }
@@ -504,15 +498,11 @@ static auto operator*(const Matrix& rMatrix, const vector_t& rVector)
 	if (rMatrix.numRows() != rVector.size())
 		throwException(MatrixSizeMismatchException, rMatrix.numRows(), rMatrix.numColumns(), 1, rVector.size());
 
-	vector_t ret(rMatrix.numColumns());
+	vector_t ret(rMatrix.numColumns(), 0.0);
 
-	for (size_t i = 0; i < ret.size(); i++)
-	{
-		ret[i] = 0;
-
-		for (size_t k = 0; k < rMatrix.numRows(); k++)
-			ret[i] += rMatrix(i, k) * rVector[k];
-	}
+	// ret[i] = sum_k rMatrix(i, k) * rVector[k]
+	if (rMatrix.numRows() > 0 && rMatrix.numColumns() > 0)
+		gemtv_into(ret.data(), rMatrix.data(), rVector.data(), rMatrix.numRows(), rMatrix.numColumns());
 
 	return ret;
 }
@@ -520,7 +510,16 @@ static auto operator*(const Matrix& rMatrix, const vector_t& rVector)
 // multiplication vector and matrix
 static auto operator*(const vector_t& rVector, const Matrix& rMatrix)
 {
-	return rMatrix.transpose() * rVector;
+	if (rMatrix.numColumns() != rVector.size())
+		throwException(MatrixSizeMismatchException, rMatrix.numColumns(), rMatrix.numRows(), 1, rVector.size());
+
+	vector_t ret(rMatrix.numRows(), 0.0);
+
+	// same as rMatrix.transpose() * rVector
+	if (rMatrix.numRows() > 0 && rMatrix.numColumns() > 0)
+		gemv_into(ret.data(), rMatrix.data(), rVector.data(), rMatrix.numRows(), rMatrix.numColumns());
+
+	return ret;
 }
 
 // multiplication matrix and constant
@@ -595,33 +594,503 @@ static auto transpose(const Matrix& rMatrix)
 	return rMatrix.transpose();
 }
 
-// inverse of matrix
-static auto inv(const Matrix& rMatrix)
+/*
+ *	LU decomposition with partial pivoting, P A = L U
+ *
+ *	Factors are stored row-major in the usual mathematical orientation, A[r][c] being rMatrix(c, r).
+ *	Solving and inverting cost O(n^2) per right-hand side once the O(n^3) factorization is done.
+ */
+class LUDecomposition
 {
-	// matrix must be square
-	if (rMatrix.numRows() != rMatrix.numColumns())
-		throwException(MatrixNotInvertibleException);
+public:
+	LUDecomposition(const Matrix& rMatrix)
+	{
+		// matrix must be square
+		if (rMatrix.numRows() != rMatrix.numColumns() || rMatrix.numRows() == 0)
+			throwException(MatrixWrongSizeException, rMatrix.numRows(), rMatrix.numColumns());
+
+		size_t n = rMatrix.numRows();
+
+		this->m_nSize = n;
+		this->m_nSign = 1;
+		this->m_bSingular = false;
+
+		this->m_lu.resize(n * n);
+		this->m_perm.resize(n);
+
+		double fScale = 0;
+
+		for (size_t r = 0; r < n; r++)
+		{
+			this->m_perm[r] = r;
+
+			for (size_t c = 0; c < n; c++)
+			{
+				this->m_lu[r * n + c] = rMatrix(c, r);
+
+				fScale = max(fScale, fabs(rMatrix(c, r)));
+			}
+		}
+
+		// pivots below this value are considered null
+		double fTolerance = 1e-14 * fScale * (double)n;
+
+		auto& lu = this->m_lu;
+
+		for (size_t k = 0; k < n; k++)
+		{
+			// find pivot
+			size_t p = k;
+
+			for (size_t r = k + 1; r < n; r++)
+				if (fabs(lu[r * n + k]) > fabs(lu[p * n + k]))
+					p = r;
+
+			if (p != k)
+			{
+				for (size_t c = 0; c < n; c++)
+					myswap(lu[p * n + c], lu[k * n + c]);
+
+				myswap(this->m_perm[p], this->m_perm[k]);
+
+				this->m_nSign = -this->m_nSign;
+			}
 
-	// simple value case
-	if (rMatrix.numRows() == 1)
+			double fPivot = lu[k * n + k];
+
+			if (fabs(fPivot) <= fTolerance)
+			{
+				this->m_bSingular = true;
+				continue;
+			}
+
+			// eliminate below pivot
+			for (size_t r = k + 1; r < n; r++)
+			{
+				double fFactor = lu[r * n + k] / fPivot;
+
+				lu[r * n + k] = fFactor;
+
+				for (size_t c = k + 1; c < n; c++)
+					lu[r * n + c] -= fFactor * lu[k * n + c];
+			}
+		}
+	}
+
+	// return true if matrix is singular
+	bool isSingular(void) const
+	{
+		return this->m_bSingular;
+	}
+
+	// return determinant
+	double determinant(void) const
+	{
+		double fDet = (double)this->m_nSign;
+
+		for (size_t k = 0; k < this->m_nSize; k++)
+			fDet *= this->m_lu[k * this->m_nSize + k];
+
+		return fDet;
+	}
+
+	// solve A x = b
+	vector_t solve(const vector_t& b) const
 	{
-		Matrix ret(1, 1);
+		size_t n = this->m_nSize;
+
+		if (b.size() != n)
+			throwException(MatrixSizeMismatchException, n, n, b.size(), 1);
 
-		if (fabs(rMatrix(0, 0)) < 1e-12)
+		if (this->m_bSingular)
 			throwException(MatrixNotInvertibleException);
 
-		ret(0, 0) = 1.0 / rMatrix(0, 0);
+		vector_t x(n);
+
+		// forward substitution with unit lower triangle
+		for (size_t r = 0; r < n; r++)
+		{
+			double fValue = b[this->m_perm[r]];
+
+			for (size_t c = 0; c < r; c++)
+				fValue -= this->m_lu[r * n + c] * x[c];
+
+			x[r] = fValue;
+		}
+
+		// backward substitution with upper triangle
+		for (size_t r = n; r-- > 0;)
+		{
+			double fValue = x[r];
+
+			for (size_t c = r + 1; c < n; c++)
+				fValue -= this->m_lu[r * n + c] * x[c];
+
+			x[r] = fValue / this->m_lu[r * n + r];
+		}
+
+		return x;
+	}
+
+	// return inverse
+	Matrix inverse(void) const
+	{
+		size_t n = this->m_nSize;
+
+		Matrix ret(n, n);
+
+		vector_t e(n, 0.0);
+
+		for (size_t c = 0; c < n; c++)
+		{
+			e[c] = 1;
+
+			auto x = solve(e);
+
+			for (size_t r = 0; r < n; r++)
+				ret(c, r) = x[r];
+
+			e[c] = 0;
+		}
 
 		return ret;
 	}
 
-	// compute determinant
-	auto fDeterminant = rMatrix.determinant();
+private:
+	size_t m_nSize;
+	int m_nSign;
+	bool m_bSingular;
+
+	vector_t m_lu;
+	std::vector<size_t> m_perm;
+};
+
+/*
+ *	Cholesky decomposition of a symmetric positive definite matrix, A = L L^T
+ *
+ *	Only the lower triangle of the input is read. Twice as fast as LU and does not need pivoting. tryDecompose() reports
+ *	a matrix that is not positive definite without throwing, for callers that fall back to another decomposition.
+ */
+class CholeskyDecomposition
+{
+public:
+	CholeskyDecomposition(void)
+	{
+		this->m_nSize = 0;
+	}
+
+	CholeskyDecomposition(const Matrix& rMatrix)
+	{
+		if (rMatrix.numRows() != rMatrix.numColumns() || rMatrix.numRows() == 0)
+			throwException(MatrixWrongSizeException, rMatrix.numRows(), rMatrix.numColumns());
+
+		if (!tryDecompose(rMatrix))
+			throwException(MatrixNotPositiveDefiniteException);
+	}
+
+	// decompose matrix, returns false if it is not square or not positive definite
+	bool tryDecompose(const Matrix& rMatrix)
+	{
+		this->m_nSize = 0;
+
+		if (rMatrix.numRows() != rMatrix.numColumns() || rMatrix.numRows() == 0)
+			return false;
+
+		size_t n = rMatrix.numRows();
+
+		this->m_l.assign(n * n, 0.0);
+
+		auto& l = this->m_l;
+
+		for (size_t r = 0; r < n; r++)
+		{
+			for (size_t c = 0; c <= r; c++)
+			{
+				double fValue = rMatrix(c, r);
+
+				for (size_t k = 0; k < c; k++)
+					fValue -= l[r * n + k] * l[c * n + k];
+
+				if (r == c)
+				{
+					if (fValue <= 0)
+						return false;
+
+					l[r * n + r] = sqrt(fValue);
+				}
+				else
+					l[r * n + c] = fValue / l[c * n + c];
+			}
+		}
+
+		this->m_nSize = n;
+
+		return true;
+	}
+
+	// return determinant
+	double determinant(void) const
+	{
+		double fDet = 1;
+
+		for (size_t k = 0; k < this->m_nSize; k++)
+			fDet *= this->m_l[k * this->m_nSize + k];
+
+		return fDet * fDet;
+	}
+
+	// solve A x = b
+	vector_t solve(const vector_t& b) const
+	{
+		size_t n = this->m_nSize;
+
+		if (b.size() != n)
+			throwException(MatrixSizeMismatchException, n, n, b.size(), 1);
+
+		vector_t x(n);
+
+		// L y = b
+		for (size_t r = 0; r < n; r++)
+		{
+			double fValue = b[r];
+
+			for (size_t c = 0; c < r; c++)
+				fValue -= this->m_l[r * n + c] * x[c];
+
+			x[r] = fValue / this->m_l[r * n + r];
+		}
+
+		// L^T x = y
+		for (size_t r = n; r-- > 0;)
+		{
+			double fValue = x[r];
+
+			for (size_t c = r + 1; c < n; c++)
+				fValue -= this->m_l[c * n + r] * x[c];
+
+			x[r] = fValue / this->m_l[r * n + r];
+		}
+
+		return x;
+	}
+
+	// return inverse
+	Matrix inverse(void) const
+	{
+		size_t n = this->m_nSize;
+
+		Matrix ret(n, n);
+
+		vector_t e(n, 0.0);
+
+		for (size_t c = 0; c < n; c++)
+		{
+			e[c] = 1;
+
+			auto x = solve(e);
+
+			for (size_t r = 0; r < n; r++)
+				ret(c, r) = x[r];
+
+			e[c] = 0;
+		}
+
+		return ret;
+	}
+
+private:
+	size_t m_nSize;
+
+	vector_t m_l;
+};
+
+/*
+ *	Householder QR decomposition of a m x n matrix with m >= n, A = Q R
+ *
+ *	Used for least-squares problems, which are solved without forming the normal equations A^T A.
+ */
+class QRDecomposition
+{
+public:
+	QRDecomposition(const Matrix& rMatrix)
+	{
+		size_t m = rMatrix.numRows();
+		size_t n = rMatrix.numColumns();
+
+		if (m < n || n == 0)
+			throwException(MatrixWrongSizeException, m, n);
+
+		this->m_nRows = m;
+		this->m_nColumns = n;
+
+		this->m_qr.resize(m * n);
+		this->m_rdiag.resize(n);
+		this->m_beta.resize(n);
+
+		double fScale = 0;
+
+		for (size_t r = 0; r < m; r++)
+			for (size_t c = 0; c < n; c++)
+			{
+				this->m_qr[r * n + c] = rMatrix(c, r);
+
+				fScale = max(fScale, fabs(rMatrix(c, r)));
+			}
+
+		auto& a = this->m_qr;
+
+		for (size_t k = 0; k < n; k++)
+		{
+			double fNorm = 0;
+
+			for (size_t r = k; r < m; r++)
+				fNorm += a[r * n + k] * a[r * n + k];
+
+			fNorm = sqrt(fNorm);
 
-	// trigger error if too small
-	if (fabs(fDeterminant) < 1e-12)
+			// rank deficient
+			if (fNorm <= 1e-14 * fScale)
+				throwException(MatrixNotInvertibleException);
+
+			double fAlpha = (a[k * n + k] > 0) ? -fNorm : fNorm;
+
+			a[k * n + k] -= fAlpha;
+
+			double fNorm2 = 0;
+
+			for (size_t r = k; r < m; r++)
+				fNorm2 += a[r * n + k] * a[r * n + k];
+
+			this->m_rdiag[k] = fAlpha;
+			this->m_beta[k] = 2.0 / fNorm2;
+
+			// apply reflector to remaining columns
+			for (size_t c = k + 1; c < n; c++)
+			{
+				double fDot = 0;
+
+				for (size_t r = k; r < m; r++)
+					fDot += a[r * n + k] * a[r * n + c];
+
+				for (size_t r = k; r < m; r++)
+					a[r * n + c] -= this->m_beta[k] * fDot * a[r * n + k];
+			}
+		}
+	}
+
+	// return x minimizing |A x - b|
+	vector_t solve(const vector_t& b) const
+	{
+		size_t m = this->m_nRows;
+		size_t n = this->m_nColumns;
+
+		if (b.size() != m)
+			throwException(MatrixSizeMismatchException, m, n, b.size(), 1);
+
+		auto y = b;
+
+		// apply Q^T
+		for (size_t k = 0; k < n; k++)
+		{
+			double fDot = 0;
+
+			for (size_t r = k; r < m; r++)
+				fDot += this->m_qr[r * n + k] * y[r];
+
+			for (size_t r = k; r < m; r++)
+				y[r] -= this->m_beta[k] * fDot * this->m_qr[r * n + k];
+		}
+
+		// back substitution with R
+		vector_t x(n);
+
+		for (size_t r = n; r-- > 0;)
+		{
+			double fValue = y[r];
+
+			for (size_t c = r + 1; c < n; c++)
+				fValue -= this->m_qr[r * n + c] * x[c];
+
+			x[r] = fValue / this->m_rdiag[r];
+		}
+
+		return x;
+	}
+
+private:
+	size_t m_nRows, m_nColumns;
+
+	vector_t m_qr, m_rdiag, m_beta;
+};
+
+// compute determinant through LU decomposition
+inline double Matrix::determinant(void) const
+{
+	// trigger error if at least one dimension is null
+	if (numRows() == 0 || numColumns() == 0)
+		throwException(MatrixWrongSizeException, numRows(), numColumns());
+
+	// determinant is only defined for square matrices
+	if (numRows() != numColumns())
+		throwException(MatrixWrongSizeException, numRows(), numColumns());
+
+	return LUDecomposition(*this).determinant();
+}
+
+// return true if matrix is square and symmetric
+static bool issymmetric(const Matrix& rMatrix)
+{
+	if (rMatrix.numRows() != rMatrix.numColumns())
+		return false;
+
+	for (size_t r = 0; r < rMatrix.numRows(); r++)
+		for (size_t c = 0; c < r; c++)
+			if (rMatrix(c, r) != rMatrix(r, c))
+				return false;
+
+	return true;
+}
+
+// solve A x = b, uses Cholesky for symmetric positive definite matrices and LU otherwise
+static vector_t solve(const Matrix& rA, const vector_t& b)
+{
+	if (issymmetric(rA))
+	{
+		CholeskyDecomposition cholesky;
+
+		if (cholesky.tryDecompose(rA))
+			return cholesky.solve(b);
+	}
+
+	return LUDecomposition(rA).solve(b);
+}
+
+// least-squares solution of A x = b for A with at least as many rows as columns
+static vector_t lstsq(const Matrix& rA, const vector_t& b)
+{
+	return QRDecomposition(rA).solve(b);
+}
+
+// inverse of matrix
+static auto inv(const Matrix& rMatrix)
+{
+	// matrix must be square
+	if (rMatrix.numRows() != rMatrix.numColumns() || rMatrix.numRows() == 0)
 		throwException(MatrixNotInvertibleException);
 
-	// compute inverse
-	return rMatrix.cofactor().transpose() / fDeterminant;
-}
\ No newline at end of file
+	// symmetric positive definite matrices (normal equations, covariances) use Cholesky
+	if (issymmetric(rMatrix))
+	{
+		CholeskyDecomposition cholesky;
+
+		if (cholesky.tryDecompose(rMatrix))
+			return cholesky.inverse();
+	}
+
+	LUDecomposition lu(rMatrix);
+
+	if (lu.isSingular())
+		throwException(MatrixNotInvertibleException);
+
+	return lu.inverse();
+}
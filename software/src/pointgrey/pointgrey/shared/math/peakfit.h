@@ -0,0 +1,577 @@
+/*
+ *	2020 (C) The Pulsar Engineering
+ *	http://www.thepulsar.be
+ *
+ *	This document is licensed under the CERN OHL-W v2 (http://ohwr.org/cernohl).
+ *
+ *	You may redistribute and modify this document under the terms of the
+ *	CERN OHL-W v2 only. This document is distributed WITHOUT ANY EXPRESS OR
+ *	IMPLIED WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY AND
+ *	FITNESS FOR APARTICULAR PURPOSE. Please refer to the CERN OHL-W v2 for
+ *	applicable conditions.
+ */
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../utils/exception.h"
+#include "../utils/parallel.h"
+
+#include "matrix.h"
+#include "vector.h"
+
+// half width of the fitted window around each peak, in FWHM
+#define PEAKFIT_WINDOW				2.0
+
+// smallest allowed width, in samples
+#define PEAKFIT_MIN_WIDTH			0.5
+
+// iteration limit, relative decrease of the cost and relative step below which the fit has converged
+#define PEAKFIT_MAX_ITERATIONS		100
+#define PEAKFIT_TOLERANCE			1e-10
+#define PEAKFIT_STEP_TOLERANCE		1e-8
+
+// damping limits
+#define PEAKFIT_MIN_LAMBDA			1e-12
+#define PEAKFIT_MAX_LAMBDA			1e12
+
+// PeakOutOfRangeException exception class
+class PeakOutOfRangeException : public IException
+{
+public:
+	PeakOutOfRangeException(size_t nPos, size_t nSize)
+	{
+		this->m_nPos = nPos;
+		this->m_nSize = nSize;
+	}
+
+	virtual std::string toString(void) const override
+	{
+		char szTmp[128];
+
+		sprintf_s(szTmp, "Peak position %zu is outside of vector of size %zu!", this->m_nPos, this->m_nSize);
+
+		return std::string(szTmp);
+	}
+
+private:
+	size_t m_nPos, m_nSize;
+};
+
+// line shape
+enum class PeakProfile
+{
+	Gaussian,
+	Lorentzian,
+	PseudoVoigt,
+};
+
+// fitted peak, positions and widths are in samples
+struct PeakFit
+{
+	PeakFit(void)
+	{
+		this->fCenter = 0;
+		this->fHeight = 0;
+		this->fWidth = 0;
+		this->fEta = 0;
+		this->fArea = 0;
+		this->fValue = 0;
+		this->fResidual = 0;
+		this->nGroup = 0;
+		this->bConverged = false;
+	}
+
+	double fCenter;			// position of the maximum
+	double fHeight;			// amplitude above the local baseline
+	double fWidth;			// full width at half maximum
+	double fEta;			// Lorentzian fraction, 0 for Gaussian and 1 for Lorentzian
+	double fArea;			// integral of the profile
+	double fValue;			// fitted value at center, including baseline and neighbouring peaks
+	double fResidual;		// RMS residual of the group the peak belongs to
+	size_t nGroup;			// index of the group of overlapping peaks
+	bool bConverged;
+};
+
+// return profile and its derivatives with respect to center, width and eta for unit amplitude
+static double peak_profile(PeakProfile eProfile, double x, double c, double w, double eta, double& rdc, double& rdw, double& rdeta)
+{
+	const double a = 4.0 * log(2.0);
+
+	double d = x - c;
+	double w2 = w * w;
+
+	// Gaussian, exp(-4 ln2 d^2 / w^2)
+	auto gaussian = [&](double& rgdc, double& rgdw)
+	{
+		double g = exp(-a * d * d / w2);
+
+		rgdc = g * 2.0 * a * d / w2;
+		rgdw = g * 2.0 * a * d * d / (w2 * w);
+
+		return g;
+	};
+
+	// Lorentzian, 1 / (1 + 4 d^2 / w^2)
+	auto lorentzian = [&](double& rldc, double& rldw)
+	{
+		double l = 1.0 / (1.0 + 4.0 * d * d / w2);
+
+		rldc = l * l * 8.0 * d / w2;
+		rldw = l * l * 8.0 * d * d / (w2 * w);
+
+		return l;
+	};
+
+	rdeta = 0;
+
+	switch (eProfile)
+	{
+	case PeakProfile::Gaussian:
+		return gaussian(rdc, rdw);
+
+	case PeakProfile::Lorentzian:
+		return lorentzian(rdc, rdw);
+
+	case PeakProfile::PseudoVoigt:
+	default:
+		{
+			double gdc, gdw, ldc, ldw;
+
+			double g = gaussian(gdc, gdw);
+			double l = lorentzian(ldc, ldw);
+
+			rdc = eta * ldc + (1.0 - eta) * gdc;
+			rdw = eta * ldw + (1.0 - eta) * gdw;
+			rdeta = l - g;
+
+			return eta * l + (1.0 - eta) * g;
+		}
+	}
+}
+
+// return area under profile
+static double peak_area(double fHeight, double fWidth, double fEta)
+{
+	const double pi = 3.14159265358979323846;
+
+	double fGaussian = fHeight * fWidth * sqrt(pi / (4.0 * log(2.0)));
+	double fLorentzian = 0.5 * pi * fHeight * fWidth;
+
+	return fEta * fLorentzian + (1.0 - fEta) * fGaussian;
+}
+
+// estimate full width at half maximum of the peak at nPos, searching crossings between the neighbouring peaks nLeft and nRight
+static double estimatePeakWidth(const vector_t& y, size_t nPos, size_t nLeft, size_t nRight)
+{
+	// floor is the higher of the lowest samples on each side, which is robust to noise unlike the first valley
+	double fLeftMin = y[nPos], fRightMin = y[nPos];
+
+	for (size_t i = nLeft; i < nPos; i++)
+		fLeftMin = min(fLeftMin, y[i]);
+
+	for (size_t i = nPos + 1; i <= nRight; i++)
+		fRightMin = min(fRightMin, y[i]);
+
+	double fHalf = 0.5 * (y[nPos] + max(fLeftMin, fRightMin));
+
+	// interpolated crossings, the search limit is used if the profile does not drop that far
+	double fLeft = (double)nLeft;
+
+	for (size_t i = nPos; i > nLeft; i--)
+	{
+		if (y[i - 1] <= fHalf)
+		{
+			fLeft = (double)(i - 1) + (fHalf - y[i - 1]) / max(y[i] - y[i - 1], 1e-300);
+			break;
+		}
+	}
+
+	double fRight = (double)nRight;
+
+	for (size_t i = nPos; i < nRight; i++)
+	{
+		if (y[i + 1] <= fHalf)
+		{
+			fRight = (double)(i + 1) - (fHalf - y[i + 1]) / max(y[i] - y[i + 1], 1e-300);
+			break;
+		}
+	}
+
+	return max(PEAKFIT_MIN_WIDTH, fRight - fLeft);
+}
+
+/*
+ *	Levenberg-Marquardt fit of a group of overlapping peaks on a linear local baseline
+ *
+ *	Parameters are the baseline offset and slope followed by amplitude, center, width and, for the pseudo-Voigt,
+ *	the Lorentzian fraction of each peak. The normal equations are built from the analytic Jacobian one sample
+ *	at a time, so that the cost per iteration is O(m p^2) for m samples and p parameters, and solved by
+ *	Cholesky with Marquardt's diagonal scaling. Widths, fractions and centers are kept in range after each step.
+ */
+static void fitPeakGroup(const vector_t& y, size_t nBegin, size_t nEnd, const std::vector<size_t>& peaks, const std::vector<double>& widths, PeakProfile eProfile, size_t nGroup, std::vector<PeakFit>& rResults)
+{
+	size_t nPeaks = peaks.size();
+	size_t nPerPeak = (eProfile == PeakProfile::PseudoVoigt) ? 4 : 3;
+	size_t nParams = 2 + nPerPeak * nPeaks;
+	size_t nSamples = nEnd - nBegin;
+
+	// slope is relative to the middle of the window for conditioning
+	double fMiddle = 0.5 * (double)(nBegin + nEnd - 1);
+
+	// initial guess
+	vector_t p(nParams, 0.0);
+
+	p[0] = min(y[nBegin], y[nEnd - 1]);
+	p[1] = 0;
+
+	for (size_t k = 0; k < nPeaks; k++)
+	{
+		double* pk = p.data() + 2 + k * nPerPeak;
+
+		pk[0] = y[peaks[k]] - p[0];
+		pk[1] = (double)peaks[k];
+		pk[2] = widths[k];
+
+		if (nPerPeak > 3)
+			pk[3] = 0.5;
+	}
+
+	// model value and Jacobian row at sample i, jacobian may be null
+	auto model = [&](const vector_t& q, size_t i, double* pJacobian)
+	{
+		double x = (double)i;
+		double fValue = q[0] + q[1] * (x - fMiddle);
+
+		if (pJacobian != nullptr)
+		{
+			pJacobian[0] = 1;
+			pJacobian[1] = x - fMiddle;
+		}
+
+		for (size_t k = 0; k < nPeaks; k++)
+		{
+			const double* qk = q.data() + 2 + k * nPerPeak;
+
+			double dc, dw, deta;
+			double f = peak_profile(eProfile, x, qk[1], qk[2], (nPerPeak > 3) ? qk[3] : 0, dc, dw, deta);
+
+			fValue += qk[0] * f;
+
+			if (pJacobian != nullptr)
+			{
+				double* jk = pJacobian + 2 + k * nPerPeak;
+
+				jk[0] = f;
+				jk[1] = qk[0] * dc;
+				jk[2] = qk[0] * dw;
+
+				if (nPerPeak > 3)
+					jk[3] = qk[0] * deta;
+			}
+		}
+
+		return fValue;
+	};
+
+	// sum of squared residuals
+	auto cost = [&](const vector_t& q)
+	{
+		double fSum = 0;
+
+		for (size_t i = nBegin; i < nEnd; i++)
+		{
+			double r = y[i] - model(q, i, nullptr);
+
+			fSum += r * r;
+		}
+
+		return fSum;
+	};
+
+	// keep parameters in range
+	auto constrain = [&](vector_t& q)
+	{
+		for (size_t k = 0; k < nPeaks; k++)
+		{
+			double* qk = q.data() + 2 + k * nPerPeak;
+
+			qk[1] = max((double)nBegin, min((double)(nEnd - 1), qk[1]));
+			qk[2] = max(PEAKFIT_MIN_WIDTH, qk[2]);
+
+			if (nPerPeak > 3)
+				qk[3] = max(0.0, min(1.0, qk[3]));
+		}
+	};
+
+	Matrix JtJ(nParams, nParams), A(nParams, nParams);
+
+	CholeskyDecomposition cholesky;
+
+	vector_t Jtr(nParams), jacobian(nParams), candidate(nParams);
+
+	double fCost = cost(p);
+	double fLambda = 1e-3;
+
+	bool bConverged = false;
+
+	for (size_t nIteration = 0; nIteration < PEAKFIT_MAX_ITERATIONS && !bConverged; nIteration++)
+	{
+		// normal equations
+		JtJ = 0;
+
+		for (auto& v : Jtr)
+			v = 0;
+
+		for (size_t i = nBegin; i < nEnd; i++)
+		{
+			double r = y[i] - model(p, i, jacobian.data());
+
+			for (size_t a = 0; a < nParams; a++)
+			{
+				Jtr[a] += jacobian[a] * r;
+
+				for (size_t b = 0; b <= a; b++)
+					JtJ(b, a) += jacobian[a] * jacobian[b];
+			}
+		}
+
+		for (size_t a = 0; a < nParams; a++)
+			for (size_t b = 0; b < a; b++)
+				JtJ(a, b) = JtJ(b, a);
+
+		// increase damping until the step lowers the cost
+		bool bAccepted = false;
+
+		while (!bAccepted)
+		{
+			if (fLambda > PEAKFIT_MAX_LAMBDA)
+			{
+				// no descent direction left, at a minimum within numerical precision
+				bConverged = true;
+				break;
+			}
+
+			A = JtJ;
+
+			for (size_t a = 0; a < nParams; a++)
+				A(a, a) += fLambda * max(JtJ(a, a), 1e-12);
+
+			if (!cholesky.tryDecompose(A))
+			{
+				fLambda *= 10;
+				continue;
+			}
+
+			vector_t step = cholesky.solve(Jtr);
+
+			double fStep = 0, fNorm = 0;
+
+			for (size_t a = 0; a < nParams; a++)
+			{
+				candidate[a] = p[a] + step[a];
+
+				fStep += step[a] * step[a];
+				fNorm += p[a] * p[a];
+			}
+
+			constrain(candidate);
+
+			double fNewCost = cost(candidate);
+
+			if (fNewCost < fCost)
+			{
+				bConverged = (fCost - fNewCost) <= PEAKFIT_TOLERANCE * fCost || fStep <= PEAKFIT_STEP_TOLERANCE * PEAKFIT_STEP_TOLERANCE * fNorm;
+				bAccepted = true;
+
+				p = candidate;
+				fCost = fNewCost;
+				fLambda = max(PEAKFIT_MIN_LAMBDA, fLambda / 10);
+			}
+			else
+				fLambda *= 10;
+		}
+	}
+
+	// results
+	double fResidual = sqrt(fCost / (double)max((size_t)1, nSamples));
+
+	for (size_t k = 0; k < nPeaks; k++)
+	{
+		const double* pk = p.data() + 2 + k * nPerPeak;
+
+		PeakFit fit;
+
+		fit.fHeight = pk[0];
+		fit.fCenter = pk[1];
+		fit.fWidth = pk[2];
+
+		switch (eProfile)
+		{
+		case PeakProfile::Gaussian:		fit.fEta = 0; break;
+		case PeakProfile::Lorentzian:	fit.fEta = 1; break;
+		default:						fit.fEta = pk[3]; break;
+		}
+
+		fit.fArea = peak_area(fit.fHeight, fit.fWidth, fit.fEta);
+		fit.fResidual = fResidual;
+		fit.nGroup = nGroup;
+		fit.bConverged = bConverged;
+
+		// evaluate model at center
+		double x = fit.fCenter;
+
+		fit.fValue = p[0] + p[1] * (x - fMiddle);
+
+		for (size_t j = 0; j < nPeaks; j++)
+		{
+			const double* pj = p.data() + 2 + j * nPerPeak;
+
+			double dc, dw, deta;
+
+			fit.fValue += pj[0] * peak_profile(eProfile, x, pj[1], pj[2], (nPerPeak > 3) ? pj[3] : 0, dc, dw, deta);
+		}
+
+		rResults[k] = fit;
+	}
+}
+
+/*
+ *	fit peaks of a spectrum
+ *
+ *	Each peak gets a window of PEAKFIT_WINDOW estimated widths on each side, and peaks whose windows overlap
+ *	are fitted together with a shared linear baseline. Groups are independent and distributed across threads.
+ *	Results are returned in the order of the input positions.
+ */
+static std::vector<PeakFit> fitPeaks(const vector_t& y, const std::vector<size_t>& peaks, PeakProfile eProfile)
+{
+	std::vector<PeakFit> ret(peaks.size());
+
+	size_t n = y.size();
+
+	for (auto& v : peaks)
+		if (v >= n)
+			throwException(PeakOutOfRangeException, v, n);
+
+	if (peaks.size() == 0 || n < 3)
+		return ret;
+
+	// sort by position
+	std::vector<size_t> order(peaks.size());
+
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return peaks[a] < peaks[b]; });
+
+	// windows
+	std::vector<double> widths(peaks.size());
+	std::vector<size_t> begins(peaks.size()), ends(peaks.size());
+
+	for (size_t s = 0; s < order.size(); s++)
+	{
+		size_t i = order[s];
+
+		size_t nLeft = (s > 0) ? peaks[order[s - 1]] : 0;
+		size_t nRight = (s + 1 < order.size()) ? peaks[order[s + 1]] : n - 1;
+
+		widths[i] = estimatePeakWidth(y, peaks[i], nLeft, nRight);
+
+		double fHalfWindow = max(1.0, PEAKFIT_WINDOW * widths[i]);
+
+		begins[i] = (size_t)max(0.0, floor((double)peaks[i] - fHalfWindow));
+		ends[i] = min(n, (size_t)ceil((double)peaks[i] + fHalfWindow) + 1);
+	}
+
+	// merge overlapping windows into groups of consecutive sorted peaks
+	struct Group
+	{
+		size_t nFirst, nLast;		// range in sorted order
+		size_t nBegin, nEnd;		// samples
+	};
+
+	std::vector<Group> groups;
+
+	for (size_t s = 0; s < order.size(); s++)
+	{
+		size_t i = order[s];
+
+		if (groups.size() > 0 && begins[i] < groups.back().nEnd)
+		{
+			groups.back().nLast = s + 1;
+			groups.back().nEnd = max(groups.back().nEnd, ends[i]);
+		}
+		else
+		{
+			Group group;
+
+			group.nFirst = s;
+			group.nLast = s + 1;
+			group.nBegin = begins[i];
+			group.nEnd = ends[i];
+
+			groups.emplace_back(group);
+		}
+	}
+
+	// fit groups
+	parallel_for(groups.size(), 1, [&](size_t nBegin, size_t nEnd)
+	{
+		for (size_t g = nBegin; g < nEnd; g++)
+		{
+			auto& group = groups[g];
+
+			std::vector<size_t> group_peaks;
+			std::vector<double> group_widths;
+
+			for (size_t s = group.nFirst; s < group.nLast; s++)
+			{
+				group_peaks.push_back(peaks[order[s]]);
+				group_widths.push_back(widths[order[s]]);
+			}
+
+			std::vector<PeakFit> results(group_peaks.size());
+
+			fitPeakGroup(y, group.nBegin, group.nEnd, group_peaks, group_widths, eProfile, g, results);
+
+			for (size_t s = group.nFirst; s < group.nLast; s++)
+				ret[order[s]] = results[s - group.nFirst];
+		}
+	});
+
+	return ret;
+}
+
+// fit peaks and return their positions on x, in place of the three point refinement
+static auto fitPeaksPosition(const vector_t& x, const vector_t& y, const std::vector<size_t>& peaks, PeakProfile eProfile)
+{
+	struct
+	{
+		vector_t x, y;
+	} ret_s;
+
+	ret_s.x = vector_t(peaks.size());
+	ret_s.y = vector_t(peaks.size());
+
+	if (x.size() != y.size())
+		throwException(InvalidSizeException);
+
+	auto fits = fitPeaks(y, peaks, eProfile);
+
+	for (size_t i = 0; i < peaks.size(); i++)
+	{
+		// keep detected position if the fit failed
+		double fCenter = (fits[i].fWidth > 0 && fits[i].fHeight > 0) ? fits[i].fCenter : (double)peaks[i];
+
+		// interpolate x between neighbouring samples
+		size_t k = min((size_t)fCenter, x.size() - 1);
+		double t = fCenter - (double)k;
+
+		ret_s.x[i] = (k + 1 < x.size()) ? (1.0 - t) * x[k] + t * x[k + 1] : x[k];
+		ret_s.y[i] = (fits[i].fWidth > 0 && fits[i].fHeight > 0) ? fits[i].fValue : y[peaks[i]];
+	}
+
+	return ret_s;
+}
@@ -14,11 +14,17 @@
 
 #include <math.h>
 
+#include <algorithm>
+#include <type_traits>
 #include <vector>
 
 #include "../utils/utils.h"
 #include "../utils/exception.h"
 
+#include "simd.h"
+#include "scratch.h"
+#include "fft.h"
+
 // InvalidSizeException class
 class InvalidSizeException : public IException
 {
@@ -32,10 +38,16 @@ public:
 // vector_t type is std::vector<double>
 using vector_t = std::vector<double>;
 
+// vectorf_t type is std::vector<float>, used for single precision processing
+using vectorf_t = std::vector<float>;
+
+// element-wise operators only take part in overload resolution for the floating point types simd<> supports
+template<typename Type> using enable_if_floating_t = typename std::enable_if<std::is_floating_point<Type>::value>::type;
+
 // return vector full of zeros
-static auto zeros(size_t nSize)
+template<typename Type = double> static auto zeros(size_t nSize)
 {
-	vector_t ret(nSize);
+	std::vector<Type> ret(nSize);
 
 	for (size_t i = 0; i < nSize; i++)
 		ret[i] = 0;
@@ -44,31 +56,29 @@ static auto zeros(size_t nSize)
 }
 
 // multiply vector by constant
-static auto operator*(const vector_t &vec, double fScale)
+template<typename Type, typename = enable_if_floating_t<Type>> static auto operator*(const std::vector<Type> &vec, double fScale)
 {
-	vector_t ret(vec.size());
+	std::vector<Type> ret(vec.size());
 
-	for (size_t i = 0; i < ret.size(); i++)
-		ret[i] = vec[i] * fScale;
+	simd<Type>().scale(ret.data(), vec.data(), (Type)fScale, ret.size());
 
 	return ret;
 }
 
 // multiply vector by constant
-static auto operator*(double fScale, const vector_t& vec)
+template<typename Type, typename = enable_if_floating_t<Type>> static auto operator*(double fScale, const std::vector<Type>& vec)
 {
-	vector_t ret(vec.size());
+	std::vector<Type> ret(vec.size());
 
-	for (size_t i = 0; i < ret.size(); i++)
-		ret[i] = fScale * vec[i];
+	simd<Type>().scale(ret.data(), vec.data(), (Type)fScale, ret.size());
 
 	return ret;
 }
 
 // power function
-static auto pow(const vector_t& vec, double fPow)
+template<typename Type> static auto pow(const std::vector<Type>& vec, double fPow)
 {
-	vector_t ret(vec.size());
+	std::vector<Type> ret(vec.size());
 
 	for (size_t i = 0; i < ret.size(); i++)
 		ret[i] = pow(vec[i], fPow);
@@ -77,9 +87,9 @@ static auto pow(const vector_t& vec, double fPow)
 }
 
 // sqrt function
-static auto sqrt(const vector_t& vec)
+template<typename Type> static auto sqrt(const std::vector<Type>& vec)
 {
-	vector_t ret(vec.size());
+	std::vector<Type> ret(vec.size());
 
 	for (size_t i = 0; i < ret.size(); i++)
 		ret[i] = sqrt(vec[i]);
@@ -88,7 +98,7 @@ static auto sqrt(const vector_t& vec)
 }
 
 // add vector to vector
-static auto operator+(const vector_t& vec1, const vector_t& vec2)
+template<typename Type, typename = enable_if_floating_t<Type>> static auto operator+(const std::vector<Type>& vec1, const std::vector<Type>& vec2)
 {
 	// return vec2 if vec1 is null
 	if (vec1.size() == 0 && vec2.size() != 0)
@@ -102,46 +112,42 @@ static auto operator+(const vector_t& vec1, const vector_t& vec2)
 	if (vec1.size() != vec2.size())
 		throwException(InvalidSizeException);
 
-	vector_t ret(vec1.size());
+	std::vector<Type> ret(vec1.size());
 
-	for (size_t i = 0; i < ret.size(); i++)
-		ret[i] = vec1[i] + vec2[i];
+	simd<Type>().add(ret.data(), vec1.data(), vec2.data(), ret.size());
 
 	return ret;
 }
 
 // add constant to vector
-static auto operator+(const vector_t& vec, double fOffset)
+template<typename Type, typename = enable_if_floating_t<Type>> static auto operator+(const std::vector<Type>& vec, double fOffset)
 {
-	vector_t ret(vec.size());
+	std::vector<Type> ret(vec.size());
 
-	for (size_t i = 0; i < ret.size(); i++)
-		ret[i] = vec[i] + fOffset;
+	simd<Type>().offset(ret.data(), vec.data(), (Type)fOffset, ret.size());
 
 	return ret;
 }
 
 // add constant to vector
-static auto operator+(double fOffset, const vector_t& vec)
+template<typename Type, typename = enable_if_floating_t<Type>> static auto operator+(double fOffset, const std::vector<Type>& vec)
 {
-	vector_t ret(vec.size());
+	std::vector<Type> ret(vec.size());
 
-	for (size_t i = 0; i < ret.size(); i++)
-		ret[i] = fOffset + vec[i];
+	simd<Type>().offset(ret.data(), vec.data(), (Type)fOffset, ret.size());
 
 	return ret;
 }
 
 // subtract vector from vector
-static auto operator-(const vector_t& vec1, const vector_t& vec2)
+template<typename Type, typename = enable_if_floating_t<Type>> static auto operator-(const std::vector<Type>& vec1, const std::vector<Type>& vec2)
 {
 	// return -vec2 if vec1 is null
 	if (vec1.size() == 0 && vec2.size() != 0)
 	{
-		vector_t ret(vec2.size());
+		std::vector<Type> ret(vec2.size());
 
-		for (size_t i = 0; i < ret.size(); i++)
-			ret[i] = -vec2[i];
+		simd<Type>().scale(ret.data(), vec2.data(), (Type)-1, ret.size());
 
 		return ret;
 	}
@@ -154,49 +160,48 @@ static auto operator-(const vector_t& vec1, const vector_t& vec2)
 	if (vec1.size() != vec2.size())
 		throwException(InvalidSizeException);
 
-	vector_t ret(vec1.size());
+	std::vector<Type> ret(vec1.size());
 
-	for (size_t i = 0; i < ret.size(); i++)
-		ret[i] = vec1[i] - vec2[i];
+	simd<Type>().sub(ret.data(), vec1.data(), vec2.data(), ret.size());
 
 	return ret;
 }
 
 // subtract constant to vector
-static auto operator-(const vector_t& vec, double fOffset)
+template<typename Type, typename = enable_if_floating_t<Type>> static auto operator-(const std::vector<Type>& vec, double fOffset)
 {
-	vector_t ret(vec.size());
+	std::vector<Type> ret(vec.size());
 
-	for (size_t i = 0; i < ret.size(); i++)
-		ret[i] = vec[i] - fOffset;
+	simd<Type>().offset(ret.data(), vec.data(), (Type)-fOffset, ret.size());
 
 	return ret;
 }
 
 // subtract constant to vector
-static auto operator-(double fOffset, const vector_t& vec)
+template<typename Type, typename = enable_if_floating_t<Type>> static auto operator-(double fOffset, const std::vector<Type>& vec)
 {
-	vector_t ret(vec.size());
+	std::vector<Type> ret(vec.size());
 
-	for (size_t i = 0; i < ret.size(); i++)
-		ret[i] = fOffset - vec[i];
+	simd<Type>().scale(ret.data(), vec.data(), (Type)-1, ret.size());
+	simd<Type>().offset(ret.data(), ret.data(), (Type)fOffset, ret.size());
 
 	return ret;
 }
 
 // divide vector by constant
-static auto operator/(const vector_t &vec, double fScale)
+template<typename Type, typename = enable_if_floating_t<Type>> static auto operator/(const std::vector<Type> &vec, double fScale)
 {
-	vector_t ret(vec.size());
+	std::vector<Type> ret(vec.size());
 
-	for (size_t i = 0; i < ret.size(); i++)
-		ret[i] = (fScale == 0) ? 0 : vec[i] / fScale;
+	// division by zero returns null vector
+	if (fScale != 0)
+		simd<Type>().div(ret.data(), vec.data(), (Type)fScale, ret.size());
 
 	return ret;
 }
 
 // add two vectors
-static const vector_t& operator+=(vector_t& vec1, const vector_t& vec2)
+template<typename Type, typename = enable_if_floating_t<Type>> static const std::vector<Type>& operator+=(std::vector<Type>& vec1, const std::vector<Type>& vec2)
 {
 	// if vec1 is null, copy vec2 into it
 	if (vec1.size() == 0)
@@ -210,23 +215,21 @@ static const vector_t& operator+=(vector_t& vec1, const vector_t& vec2)
 			throwException(InvalidSizeException);
 
 		// add each element
-		for (size_t i = 0; i < vec1.size(); i++)
-			vec1[i] += vec2[i];
+		simd<Type>().add(vec1.data(), vec1.data(), vec2.data(), vec1.size());
 	}
 
 	// return vector
 	return vec1;
 }
 
-static const vector_t& operator-=(vector_t& vec1, const vector_t& vec2)
+template<typename Type, typename = enable_if_floating_t<Type>> static const std::vector<Type>& operator-=(std::vector<Type>& vec1, const std::vector<Type>& vec2)
 {
 	// if vec1 is null, copy -vec2 into it
 	if (vec1.size() == 0)
 	{
 		vec1.resize(vec2.size());
 
-		for (size_t i = 0; i < vec1.size(); i++)
-			vec1[i] = -vec2[i];
+		simd<Type>().scale(vec1.data(), vec2.data(), (Type)-1, vec1.size());
 	}
 	// otherelse subtract vectors
 	else
@@ -236,22 +239,21 @@ static const vector_t& operator-=(vector_t& vec1, const vector_t& vec2)
 			throwException(InvalidSizeException);
 
 		// subtract each elements
-		for (size_t i = 0; i < vec1.size(); i++)
-			vec1[i] -= vec2[i];
+		simd<Type>().sub(vec1.data(), vec1.data(), vec2.data(), vec1.size());
 	}
 
 	return vec1;
 }
 
 // return vector if 'nSize' elements that goes linearly from fMin to fMax
-static auto linspace(double fMin, double fMax, size_t nSize)
+template<typename Type = double> static auto linspace(double fMin, double fMax, size_t nSize)
 {
 	// require at least 2 elements
 	if (nSize <= 1)
 		throwException(InvalidSizeException);
 
 	// return linear interpolation
-	vector_t ret(nSize);
+	std::vector<Type> ret(nSize);
 
 	for (size_t i = 0; i < nSize; i++)
 	{
@@ -264,39 +266,29 @@ static auto linspace(double fMin, double fMax, size_t nSize)
 }
 
 // return maximum of vector
-static double maxof(const vector_t& rArray)
+template<typename Type> static Type maxof(const std::vector<Type>& rArray)
 {
 	// throw exception if size is null
 	if (rArray.size() == 0)
 		throwException(InvalidSizeException);
 
 	// get maximum
-	double fRet = rArray[0];
-
-	for (size_t i = 1; i < rArray.size(); i++)
-		fRet = max(fRet, rArray[i]);
-
-	return fRet;
+	return simd<Type>().maxval(rArray.data(), rArray.size());
 }
 
 // return minimum of vector
-static double minof(const vector_t& rArray)
+template<typename Type> static Type minof(const std::vector<Type>& rArray)
 {
 	// throw exception if size is null
 	if (rArray.size() == 0)
 		return 0;
 
 	// get minimum
-	double fRet = rArray[0];
-
-	for (size_t i = 1; i < rArray.size(); i++)
-		fRet = min(fRet, rArray[i]);
-
-	return fRet;
+	return simd<Type>().minval(rArray.data(), rArray.size());
 }
 
 // maximum of two vectors
-static auto maxvec(const vector_t& vec1, const vector_t& vec2)
+template<typename Type> static auto maxvec(const std::vector<Type>& vec1, const std::vector<Type>& vec2)
 {
 	// return vec2 if vec1 is null
 	if (vec1.size() == 0 && vec2.size() != 0)
@@ -310,16 +302,15 @@ static auto maxvec(const vector_t& vec1, const vector_t& vec2)
 	if (vec1.size() != vec2.size())
 		throwException(InvalidSizeException);
 
-	vector_t ret(vec1.size());
+	std::vector<Type> ret(vec1.size());
 
-	for (size_t i = 0; i < ret.size(); i++)
-		ret[i] = max(vec1[i], vec2[i]);
+	simd<Type>().vmax(ret.data(), vec1.data(), vec2.data(), ret.size());
 
 	return ret;
 }
 
 // minimum of two vectors
-static auto minvec(const vector_t& vec1, const vector_t& vec2)
+template<typename Type> static auto minvec(const std::vector<Type>& vec1, const std::vector<Type>& vec2)
 {
 	// return vec2 if vec1 is null
 	if (vec1.size() == 0 && vec2.size() != 0)
@@ -333,59 +324,216 @@ static auto minvec(const vector_t& vec1, const vector_t& vec2)
 	if (vec1.size() != vec2.size())
 		throwException(InvalidSizeException);
 
-	vector_t ret(vec1.size());
+	std::vector<Type> ret(vec1.size());
 
-	for (size_t i = 0; i < ret.size(); i++)
-		ret[i] = min(vec1[i], vec2[i]);
+	simd<Type>().vmin(ret.data(), vec1.data(), vec2.data(), ret.size());
 
 	return ret;
 }
 
-// convolution of vector with kernel
-static auto conv(const vector_t& rInput, const vector_t& rKernel)
+// direct convolution, elements whose window lies inside the vector skip the index clamping
+template<typename Type> static void conv_direct_into(std::vector<Type>& rOutput, const std::vector<Type>& rInput, const std::vector<Type>& rKernel)
 {
-	// create temp vector
-	vector_t ret(rInput.size());
+	int n = (int)rInput.size();
+	int k = (int)rKernel.size();
+	int h = k >> 1;
 
-	// get size of input kernel
-	size_t nKernelSize = rKernel.size();
+	// interior is [h, n - k + h], may be empty if kernel is larger than vector
+	int nFirst = min(h, n);
+	int nLast = max(nFirst, n - k + h + 1);
 
-	// scan all element of original vector
-	for (size_t i = 0; i < rInput.size(); i++)
+	// edge element, indices are clamped to the vector
+	auto edge = [&](int i)
 	{
-		// initialize element to zero
-		ret[i] = 0;
+		Type fValue = 0;
 
-		// browse vector
-		for (size_t j = 0; j < nKernelSize; j++)
-			ret[i] += rKernel[j] * rInput[bound((int)(i+j) - (int)(nKernelSize>>1), 0, (int)rInput.size() - 1)];
+		for (int j = 0; j < k; j++)
+			fValue += rKernel[j] * rInput[bound(i + j - h, 0, n - 1)];
+
+		rOutput[i] = fValue;
+	};
+
+	for (int i = 0; i < nFirst; i++)
+		edge(i);
+
+	for (int i = nFirst; i < nLast; i++)
+		rOutput[i] = simd<Type>().dot(rKernel.data(), rInput.data() + (i - h), (size_t)k);
+
+	for (int i = nLast; i < n; i++)
+		edge(i);
+}
+
+// convolution through real FFT, input is extended by repeating the edges so that results match the direct path
+template<typename Type> static void conv_fft_into(std::vector<Type>& rOutput, const std::vector<Type>& rInput, const std::vector<Type>& rKernel)
+{
+	size_t n = rInput.size();
+	size_t k = rKernel.size();
+	size_t h = k >> 1;
+
+	size_t nSize = fft_size(n + k - 1);
+	size_t nBins = (nSize >> 1) + 1;
+
+	auto ext = scratch<double>(nSize);
+	auto ker = scratch<double>(nSize);
+	auto ext_bins = scratch<complex_t>(nBins);
+	auto ker_bins = scratch<complex_t>(nBins);
+
+	// extended input and zero padded kernel
+	for (size_t i = 0; i < nSize; i++)
+	{
+		(*ext)[i] = (i < n + k - 1) ? (double)rInput[bound((int)i - (int)h, 0, (int)n - 1)] : 0.0;
+		(*ker)[i] = (i < k) ? (double)rKernel[i] : 0.0;
 	}
 
-	// return temp vector
+	auto& plan = rfft_plan(nSize);
+
+	plan.forward(ext->data(), ext_bins->data());
+	plan.forward(ker->data(), ker_bins->data());
+
+	// correlation is product with conjugate of kernel
+	for (size_t i = 0; i < nBins; i++)
+		(*ext_bins)[i] *= std::conj((*ker_bins)[i]);
+
+	plan.inverse(ext_bins->data(), ext->data());
+
+	for (size_t i = 0; i < n; i++)
+		rOutput[i] = (Type)(*ext)[i];
+}
+
+// return true if FFT convolution is expected to be faster than the direct one
+static bool conv_use_fft(size_t nSize, size_t nKernelSize)
+{
+	// small kernels are always faster in direct form
+	if (nKernelSize < 64)
+		return false;
+
+	size_t nFFTSize = fft_size(nSize + nKernelSize - 1);
+
+	// 3 half-size complex transforms against one multiply-add per tap, constant is measured
+	double fDirectCost = (double)nSize * (double)nKernelSize;
+	double fFFTCost = 16.0 * (double)nFFTSize * log2((double)nFFTSize);
+
+	return fFFTCost < fDirectCost;
+}
+
+// convolution of vector with kernel into output vector, input and output may be the same vector
+template<typename Type> static void conv_into(std::vector<Type>& rOutput, const std::vector<Type>& rInput, const std::vector<Type>& rKernel)
+{
+	// work on a copy if output overwrites input
+	if (&rOutput == &rInput)
+	{
+		auto tmp = scratch<Type>(rInput.size());
+
+		*tmp = rInput;
+
+		conv_into(rOutput, *tmp, rKernel);
+
+		return;
+	}
+
+	// resize output, does not reallocate if capacity is large enough
+	rOutput.resize(rInput.size());
+
+	if (rInput.size() == 0)
+		return;
+
+	// empty kernel returns null vector
+	if (rKernel.size() == 0)
+	{
+		std::fill(rOutput.begin(), rOutput.end(), (Type)0);
+
+		return;
+	}
+
+	// dispatch on kernel size
+	if (conv_use_fft(rInput.size(), rKernel.size()))
+		conv_fft_into(rOutput, rInput, rKernel);
+	else
+		conv_direct_into(rOutput, rInput, rKernel);
+}
+
+// convolution of vector with kernel
+template<typename Type> static auto conv(const std::vector<Type>& rInput, const std::vector<Type>& rKernel)
+{
+	std::vector<Type> ret;
+
+	conv_into(ret, rInput, rKernel);
+
 	return ret;
 }
 
-// boxcar lowpass filter on vector
-static auto boxcar(const vector_t& vec, size_t nKernelSize)
+// boxcar lowpass filter into output vector, input and output may be the same vector
+template<typename Type> static void boxcar_into(std::vector<Type>& rOutput, const std::vector<Type>& rInput, size_t nKernelSize)
 {
-	// return original vec if size is lower or equal to 1 (1: no effect, 0: undefined behavior)
+	// copy original vec if size is lower or equal to 1 (1: no effect, 0: undefined behavior)
 	if (nKernelSize <= 1)
-		return vec;
+	{
+		if (&rOutput != &rInput)
+			rOutput.assign(rInput.begin(), rInput.end());
+
+		return;
+	}
+
+	// work on a copy if output overwrites input
+	if (&rOutput == &rInput)
+	{
+		auto tmp = scratch<Type>(rInput.size());
 
-	// create kernel
-	vector_t kernel(nKernelSize);
+		*tmp = rInput;
 
-	for (auto& v : kernel)
-		v = 1.0 / (double)nKernelSize;
+		boxcar_into(rOutput, *tmp, nKernelSize);
 
-	// return convolution
-	return conv(vec, kernel);
+		return;
+	}
+
+	rOutput.resize(rInput.size());
+
+	if (rInput.size() == 0)
+		return;
+
+	// all kernel elements share the same weight
+	double fWeight = 1.0 / (double)nKernelSize;
+
+	// window of element i covers [i - k/2, i - k/2 + k - 1], indices are clamped to the vector like conv()
+	int nLast = (int)rInput.size() - 1;
+	int nHalf = (int)(nKernelSize >> 1);
+	int nKernel = (int)nKernelSize;
+
+	// running sum is kept in double precision so that cost does not depend on the kernel size
+	double fSum = 0;
+
+	for (int j = 0; j < nKernel; j++)
+		fSum += (double)rInput[bound(j - nHalf, 0, nLast)];
+
+	for (int i = 0; i <= nLast; i++)
+	{
+		rOutput[i] = (Type)(fWeight * fSum);
+
+		// slide window by one element
+		fSum += (double)rInput[bound(i - nHalf + nKernel, 0, nLast)] - (double)rInput[bound(i - nHalf, 0, nLast)];
+	}
+}
+
+// boxcar lowpass filter on vector
+template<typename Type> static auto boxcar(const std::vector<Type>& vec, size_t nKernelSize)
+{
+	std::vector<Type> ret;
+
+	boxcar_into(ret, vec, nKernelSize);
+
+	return ret;
+}
+
+// boxcar lowpass filter applied in place
+template<typename Type> static void boxcar_inplace(std::vector<Type>& vec, size_t nKernelSize)
+{
+	boxcar_into(vec, vec, nKernelSize);
 }
 
 // power
-static auto power(const vector_t& vec, double fPower)
+template<typename Type> static auto power(const std::vector<Type>& vec, double fPower)
 {
-	vector_t ret(vec.size());
+	std::vector<Type> ret(vec.size());
 
 	for (size_t i = 0; i < ret.size(); i++)
 		ret[i] = pow(vec[i], fPower);
@@ -394,21 +542,140 @@ static auto power(const vector_t& vec, double fPower)
 }
 
 // sum
-static auto sum(const vector_t& vec)
+template<typename Type> static auto sum(const std::vector<Type>& vec)
 {
-	double fSum = 0;
+	return simd<Type>().sum(vec.data(), vec.size());
+}
+
+// dot product
+template<typename Type> static Type dot(const std::vector<Type>& vec1, const std::vector<Type>& vec2)
+{
+	// throw error is vector are not the same size
+	if (vec1.size() != vec2.size())
+		throwException(InvalidSizeException);
+
+	return simd<Type>().dot(vec1.data(), vec2.data(), vec1.size());
+}
+
+// element-wise product
+template<typename Type> static auto mult(const std::vector<Type>& vec1, const std::vector<Type>& vec2)
+{
+	// throw error is vector are not the same size
+	if (vec1.size() != vec2.size())
+		throwException(InvalidSizeException);
+
+	std::vector<Type> ret(vec1.size());
+
+	simd<Type>().mul(ret.data(), vec1.data(), vec2.data(), ret.size());
+
+	return ret;
+}
+
+// fused multiply-add, return vec1 * fScale + vec2
+template<typename Type> static auto muladd(const std::vector<Type>& vec1, double fScale, const std::vector<Type>& vec2)
+{
+	// throw error is vector are not the same size
+	if (vec1.size() != vec2.size())
+		throwException(InvalidSizeException);
+
+	std::vector<Type> ret(vec1.size());
+
+	simd<Type>().fma(ret.data(), vec1.data(), (Type)fScale, vec2.data(), ret.size());
+
+	return ret;
+}
+
+// limit elements to [fMin, fMax]
+template<typename Type> static auto clamp(const std::vector<Type>& vec, double fMin, double fMax)
+{
+	std::vector<Type> ret(vec.size());
 
-	for (auto& v : vec)
-		fSum += v;
+	simd<Type>().clamp(ret.data(), vec.data(), (Type)fMin, (Type)fMax, ret.size());
 
-	return fSum;
+	return ret;
 }
 
 // mean value
-static auto mean(const vector_t& vec)
+template<typename Type> static auto mean(const std::vector<Type>& vec)
 {
 	if (vec.size() == 0)
 		throwException(InvalidSizeException);
 
 	return sum(vec) / vec.size();
-}
\ No newline at end of file
+}
+
+// full cross-correlation, ret[m + vec2.size() - 1] = sum of vec1[i + m] * vec2[i] with zero padding
+template<typename Type> static auto xcorr(const std::vector<Type>& vec1, const std::vector<Type>& vec2)
+{
+	size_t n1 = vec1.size();
+	size_t n2 = vec2.size();
+
+	if (n1 == 0 || n2 == 0)
+		return std::vector<Type>();
+
+	std::vector<Type> ret(n1 + n2 - 1);
+
+	// direct form for small vectors
+	if (!conv_use_fft(max(n1, n2), min(n1, n2)))
+	{
+		for (size_t l = 0; l < ret.size(); l++)
+		{
+			// lag m = l - (n2 - 1), overlap is i in [max(0, -m), min(n2, n1 - m))
+			size_t nBegin = (l < n2 - 1) ? (n2 - 1 - l) : 0;
+			size_t nEnd = min(n2, n1 + n2 - 1 - l);
+
+			ret[l] = simd<Type>().dot(vec1.data() + (l + nBegin - (n2 - 1)), vec2.data() + nBegin, nEnd - nBegin);
+		}
+
+		return ret;
+	}
+
+	// FFT form, negative lags wrap around to the end of the circular correlation
+	size_t nSize = fft_size(n1 + n2 - 1);
+	size_t nBins = (nSize >> 1) + 1;
+
+	auto a = scratch<double>(nSize);
+	auto b = scratch<double>(nSize);
+	auto a_bins = scratch<complex_t>(nBins);
+	auto b_bins = scratch<complex_t>(nBins);
+
+	for (size_t i = 0; i < nSize; i++)
+	{
+		(*a)[i] = (i < n1) ? (double)vec1[i] : 0.0;
+		(*b)[i] = (i < n2) ? (double)vec2[i] : 0.0;
+	}
+
+	auto& plan = rfft_plan(nSize);
+
+	plan.forward(a->data(), a_bins->data());
+	plan.forward(b->data(), b_bins->data());
+
+	for (size_t i = 0; i < nBins; i++)
+		(*a_bins)[i] *= std::conj((*b_bins)[i]);
+
+	plan.inverse(a_bins->data(), a->data());
+
+	for (size_t l = 0; l < ret.size(); l++)
+		ret[l] = (Type)(*a)[(l + nSize - (n2 - 1)) % nSize];
+
+	return ret;
+}
+
+// convert vector to another scalar type into output vector
+template<typename TypeOut, typename TypeIn> static void convert_into(std::vector<TypeOut>& rOutput, const std::vector<TypeIn>& rInput)
+{
+	rOutput.resize(rInput.size());
+
+	for (size_t i = 0; i < rInput.size(); i++)
+		rOutput[i] = (TypeOut)rInput[i];
+}
+
+// convert vector to another scalar type
+template<typename TypeOut, typename TypeIn> static auto convert(const std::vector<TypeIn>& rInput)
+{
+	std::vector<TypeOut> ret;
+
+	convert_into(ret, rInput);
+
+	return ret;
+}